@@ -0,0 +1,233 @@
+/**
+ * @file bench.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief benchmark of the line storage of dsort
+ *
+ * @details stores the same random lines once with one strdup per line in a
+						growing pointer list sorted by qsort with strcmp, as dsort did before,
+						and once in the arena and index of lines.h. Prints the number of
+						allocations and the time to store and to sort the lines for both and
+						checks that they end up in the same order. Half of the lines start
+						with one of a few shared path prefixes, so the key prefixes tie.
+ *
+ * @date 10.11.2015
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "lines.h"
+
+/* === Constants === */
+
+/**
+ * @brief number of lines if none is given
+ */
+#define BENCH_LINES (1000000)
+
+/**
+ * @brief longest random part of a line
+ */
+#define BENCH_WORD (40)
+
+/* === Global Variables === */
+
+/** Name of the program */
+static const char *progname = "bench"; /* default name */
+
+/** random lines, back to back with their terminating zeros */
+static char *text = NULL;
+
+/** the lines in text */
+static char **lines = NULL;
+
+/** lines stored with strdup */
+static char **copies = NULL;
+
+/** number of lines in copies */
+static int copy_count = 0;
+
+/** lines stored in the arena */
+static struct line_list list;
+
+/* === Prototypes === */
+
+/** free_resources
+ * @brief free allocated resources
+ */
+static void free_resources(void);
+
+/** program exit point for errors
+ * @brief free resources and terminate program on program error
+ * @param exitcode exit code
+ * @param fmt format string
+ */
+static void bail_out(int exitcode, const char *fmt, ...);
+
+/** compare two strings
+ * @brief compare string function for qsort - uses stcmp
+ * @param p1 pointer to the first string
+ * @param p2 pointer to the second string
+ * @return 0 if strings are equal, != 0 otherwise
+ */
+static int str_cmp_p(const void *p1, const void *p2);
+
+/** generate the lines
+ * @brief fill text and lines with random lines
+ * @param count Number of lines
+ */
+static void make_lines(int count);
+
+/** current time
+ * @brief monotonic time in ms
+ * @return milliseconds since an arbitrary point
+ */
+static double now_ms(void);
+
+/* === Implementations === */
+
+static void free_resources(void) {
+	for (int i = 0; i < copy_count; i++) {
+		free(copies[i]);
+	}
+	copy_count = 0;
+	free(copies);
+	copies = NULL;
+	free(lines);
+	lines = NULL;
+	free(text);
+	text = NULL;
+	lines_free(&list);
+}
+
+static void bail_out(int exitcode, const char *fmt, ...) {
+	va_list ap;
+
+	(void) fprintf(stderr, "%s: ", progname);
+	if (fmt != NULL) {
+		va_start(ap, fmt);
+		(void) vfprintf(stderr, fmt, ap);
+		va_end(ap);
+	}
+	if (errno != 0) {
+		(void) fprintf(stderr, ": %s", strerror(errno));
+	}
+	(void) fprintf(stderr, "\n");
+
+	free_resources();
+	exit(exitcode);
+}
+
+static int str_cmp_p(const void *p1, const void *p2) {
+	return strcmp(* (char * const *) p1, * (char * const *) p2);
+}
+
+static void make_lines(int count) {
+	static const char *dirs[] = { "/usr/share/doc/", "/usr/share/man/", "/usr/lib/", "/etc/" };
+	size_t size = (size_t) count * (16 + BENCH_WORD + 2);
+	size_t used = 0;
+
+	if ((text = malloc(size)) == NULL || (lines = malloc(count * sizeof (char *))) == NULL) {
+		bail_out(EXIT_FAILURE, "malloc");
+	}
+	srand(1);
+	for (int i = 0; i < count; i++) {
+		int length = 1 + rand() % BENCH_WORD;
+
+		lines[i] = text + used;
+		if (rand() % 2 == 0) {
+			const char *dir = dirs[rand() % 4];
+			(void) strcpy(text + used, dir);
+			used += strlen(dir);
+		}
+		for (int j = 0; j < length; j++) {
+			/* few letters, so some lines occur twice */
+			text[used++] = 'a' + (j < 3 ? rand() % 26 : rand() % 4);
+		}
+		text[used++] = '\n';
+		text[used++] = '\0';
+	}
+}
+
+static double now_ms(void) {
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * @brief Program entry point
+ * @param argc The argument counter
+ * @param argv The argument vector
+ * @return EXIT_SUCCESS on success and EXIT_FAILURE if the orders differ
+ */
+int main(int argc, char **argv) {
+	unsigned long allocs = 0;
+	int count = BENCH_LINES;
+	int size = 0;
+	double start, stored, sorted;
+
+	if (argc > 0) {
+		progname = argv[0];
+	}
+	if (argc > 2 || (argc == 2 && (count = atoi(argv[1])) < 1)) {
+		bail_out(EXIT_FAILURE, "Usage: %s [<lines>]", progname);
+	}
+	make_lines(count);
+	(void) printf("%d lines\n", count);
+	(void) printf("%-8s %12s %12s %12s\n", "storage", "allocations", "store ms", "sort ms");
+
+	/* before: a strdup per line, the list grows like dsort's did */
+	start = now_ms();
+	for (int i = 0; i < count; i++) {
+		if (copies == NULL || size == i) {
+			size = copies == NULL ? 8 : size * 2;
+			if ((copies = realloc(copies, size * sizeof (char *))) == NULL) {
+				bail_out(EXIT_FAILURE, "realloc");
+			}
+			allocs++;
+		}
+		if ((copies[i] = strdup(lines[i])) == NULL) {
+			bail_out(EXIT_FAILURE, "strdup");
+		}
+		copy_count++;
+		allocs++;
+	}
+	stored = now_ms();
+	qsort(copies, count, sizeof (char *), str_cmp_p);
+	sorted = now_ms();
+	(void) printf("%-8s %12lu %12.1f %12.1f\n", "strdup", allocs, stored - start, sorted - stored);
+
+	/* after: the arena and its index */
+	lines_init(&list, CHUNK_SIZE);
+	start = now_ms();
+	for (int i = 0; i < count; i++) {
+		if (lines_add(&list, lines[i], strlen(lines[i])) != 0) {
+			bail_out(EXIT_FAILURE, "lines_add");
+		}
+	}
+	stored = now_ms();
+	lines_sort(&list);
+	sorted = now_ms();
+	(void) printf("%-8s %12lu %12.1f %12.1f\n", "arena", list.allocs, stored - start, sorted - stored);
+
+	for (int i = 0; i < count; i++) {
+		const struct line_ref *ref = &list.items[i];
+		if (strlen(copies[i]) != ref->length ||
+			memcmp(copies[i], lines_text(&list, ref), ref->length) != 0) {
+			errno = 0;
+			bail_out(EXIT_FAILURE, "line %d differs", i);
+		}
+	}
+	(void) printf("same order\n");
+
+	free_resources();
+	return EXIT_SUCCESS;
+}
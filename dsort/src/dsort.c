@@ -7,6 +7,13 @@
  *
  * @details dsort executes and saves the ouput of command1 and command2 in a list, 
 						the list will then be sorted and all duplicated lines will be printed. 
+						the lines are copied into a chunked arena and sorted through an index 
+						of their positions and key prefixes (see lines.h). 
+						with -m <budget> the lines are kept in memory only up to budget KiB: 
+						a full list is sorted and spilled as a run to a temporary file, at the 
+						end the runs are merged with a heap of their current lines and every 
+						duplicated line is printed once as soon as the merge reaches it. 
+						more than MERGE_WAYS runs are merged in several passes. 
  *
  * @date 10.11.2015
  * 
@@ -20,14 +27,27 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <strings.h>
+#include <limits.h>
+
+#include "lines.h"
 
 /* === Constants === */
 
 /**
- * @brief max length for the strings in string_list 
+ * @brief max length for the lines in cmd_out 
  */
 #define LINE_SIZE (1024)
 
+/**
+ * @brief max number of runs merged at once, each one needs an open file and a line buffer
+ */
+#define MERGE_WAYS (64)
+
+/**
+ * @brief smallest memory budget in KiB, it has to hold at least a few lines
+ */
+#define MIN_BUDGET (16)
+
 /* === Macros === */
 
 /**
@@ -39,25 +59,42 @@
 #define DEBUG(...)
 #endif
 
+/* === Type Definitions === */
+
+/** struct for a list of sorted runs */
+struct run_list {
+	/** temporary files, each holds one run */
+	FILE **files;
+	/** size of the list */
+	int size;
+	/** current run count of the list */
+	int run_count;
+};
+
+/** struct for a run taking part in a merge */
+struct merge_source {
+	/** file of the run */
+	FILE *file;
+	/** current line of the run */
+	char line[LINE_SIZE];
+};
+
 /* === Global Variables === */
 
 /** Name of the program */
 static const char *progname = "dsort"; /* default name */
 
 /** list for command output */
-static struct string_list cmd_out;
+static struct line_list cmd_out;
 
-/* === Type Definitions === */
+/** memory budget of cmd_out in bytes, 0 to keep all lines in memory */
+static size_t mem_budget = 0;
 
-/** struct for a list of strings */
-struct string_list { 
-	/** current items in the list */
-	char **items;		
-	/** size of the list */
-	int size;      
-	/** current item count of the list */ 
-	int item_count; 
-};
+/** bytes of cmd_out in use, the lines and their index entries */
+static size_t mem_used = 0;
+
+/** sorted runs spilled to temporary files */
+static struct run_list runs;
 
 /* === Prototypes === */
 
@@ -66,14 +103,6 @@ struct string_list {
  */
 static void free_resources(void);
 
-/** compare two strings
- * @brief compare string function for qsort - uses stcmp
- * @param p1 pointer to the first string
- * @param p2 pointer to the second string
- * @return 0 if strings are equal, != 0 otherwise
- */
-static int str_cmp_p(const void *p1, const void *p2);
-
 /** program exit point for errors
  * @brief free resources and terminate program on program error
  * @param exitcode exit code
@@ -93,6 +122,49 @@ static void wait_for_child(pid_t child_pid);
  */
 static void pipe_from_command(char *command);
 
+/** add a line to cmd_out
+ * @brief append a copy of a line to cmd_out, spill cmd_out first if the line 
+ * would exceed the memory budget
+ * @param line The line
+ * @param length Length of the line
+ */
+static void add_line(const char *line, size_t length);
+
+/** spill cmd_out to a run
+ * @brief sort cmd_out, write it to a temporary file, add the file to runs and 
+ * empty cmd_out
+ */
+static void spill_run(void);
+
+/** add a run to runs
+ * @brief append a temporary file to runs
+ * @param file The file, positioned at the start of the run
+ */
+static void add_run(FILE *file);
+
+/** merge runs
+ * @brief k-way merge runs with a heap ordered by their current lines
+ * @param files The files of the runs, closed when the merge is done
+ * @param count Number of runs, at most MERGE_WAYS
+ * @param out Stream for the merged lines
+ * @param dups_only Write only one line of every group of duplicated lines
+ */
+static void merge_runs(FILE **files, int count, FILE *out, int dups_only);
+
+/** restore the heap order
+ * @brief sift a source of the heap down to its place
+ * @param heap The heap
+ * @param count Number of sources in the heap
+ * @param i Index of the source
+ */
+static void heap_sift_down(struct merge_source **heap, int count, int i);
+
+/** print the duplicated lines of all runs
+ * @brief spill the rest of cmd_out, merge the runs in passes of MERGE_WAYS 
+ * until one pass is left and print its duplicated lines to stdout
+ */
+static void print_duplicates(void);
+
 /** pipe cmd_out to stdin of command
  * @brief run command in child process and pipe parent:cmd_out to child:stdin 
  * @param command The command to execute
@@ -102,19 +174,14 @@ static void pipe_to_command(char *command);
 /* === Implementations === */
 
 static void free_resources(void) {
-	for (int i = 0; i < cmd_out.item_count; i++) {
-		free(cmd_out.items[i]);
+	lines_free(&cmd_out);
+	for (int i = 0; i < runs.run_count; i++) {
+		(void) fclose(runs.files[i]);
 	}
-	free(&cmd_out.items[0]);
-	cmd_out.size = 0;
-	cmd_out.items = NULL;
-}
-
-static int str_cmp_p(const void *p1, const void *p2) {
-	/* The actual arguments to this function are "pointers to
-		pointers to char", but strcmp(3) arguments are "pointers
-		to char", hence the following cast plus dereference */
-	return strcmp(* (char * const *) p1, * (char * const *) p2);
+	free(runs.files);
+	runs.size = 0;
+	runs.run_count = 0;
+	runs.files = NULL;
 }
 
 static void bail_out(int exitcode, const char *fmt, ...) {
@@ -197,15 +264,7 @@ static void pipe_from_command(char *command) {
 			}
 
 			while(fgets(buffer, sizeof buffer, read_stream) != NULL) {
-				if (cmd_out.items == NULL) {
-					cmd_out.size = 8;
-					cmd_out.items = malloc(cmd_out.size * sizeof (char *));
-				} else if (cmd_out.size == cmd_out.item_count) {
-					cmd_out.size *= 2;
-					cmd_out.items = realloc(cmd_out.items, cmd_out.size * sizeof  (char *));
-				}
-				cmd_out.items[cmd_out.item_count] = strdup(buffer);
-				cmd_out.item_count++;
+				add_line(buffer, strlen(buffer));
 			}
 
 			if (fclose(read_stream) != 0) {
@@ -217,6 +276,151 @@ static void pipe_from_command(char *command) {
 		}
 }
 
+static void add_line(const char *line, size_t length) {
+	size_t cost = length + sizeof (struct line_ref);
+
+	if (mem_budget != 0 && mem_used + cost > mem_budget && cmd_out.item_count > 0) {
+		spill_run();
+	}
+	if (lines_add(&cmd_out, line, length) != 0) {
+		bail_out(errno, "could not store line");
+	}
+	mem_used += cost;
+}
+
+static void spill_run(void) {
+	FILE *file;
+
+	DEBUG("spill run of %d lines\n", cmd_out.item_count);
+	lines_sort(&cmd_out);
+	if ((file = tmpfile()) == NULL) {
+		bail_out(errno, "could not create temporary file");
+	}
+	if (lines_write(&cmd_out, file) == EOF) {
+		(void) fclose(file);
+		bail_out(errno, "could not write run");
+	}
+	lines_clear(&cmd_out);
+	mem_used = 0;
+	/* flushes the run, the merge reads it from the start */
+	if (fseek(file, 0, SEEK_SET) != 0) {
+		(void) fclose(file);
+		bail_out(errno, "could not rewind run");
+	}
+	add_run(file);
+}
+
+static void add_run(FILE *file) {
+	if (runs.size == runs.run_count) {
+		int size = runs.size == 0 ? 8 : runs.size * 2;
+		FILE **files = realloc(runs.files, size * sizeof (FILE *));
+		if (files == NULL) {
+			(void) fclose(file);
+			bail_out(errno, "could not grow the run list");
+		}
+		runs.files = files;
+		runs.size = size;
+	}
+	runs.files[runs.run_count++] = file;
+}
+
+static void merge_runs(FILE **files, int count, FILE *out, int dups_only) {
+	/* static, MERGE_WAYS line buffers are too large for the stack */
+	static struct merge_source sources[MERGE_WAYS];
+	struct merge_source *heap[MERGE_WAYS];
+	char last[LINE_SIZE];
+	int last_count = 0;
+	int n = 0;
+
+	for (int i = 0; i < count; i++) {
+		struct merge_source *source = &sources[i];
+		source->file = files[i];
+		if (fgets(source->line, sizeof source->line, source->file) != NULL) {
+			heap[n++] = source;
+		} else if (ferror(source->file)) {
+			bail_out(errno, "could not read run");
+		}
+	}
+	for (int i = n / 2 - 1; i >= 0; i--) {
+		heap_sift_down(heap, n, i);
+	}
+
+	while (n > 0) {
+		struct merge_source *source = heap[0];
+
+		if (!dups_only) {
+			if (fputs(source->line, out) == EOF) {
+				bail_out(errno, "could not write merged run");
+			}
+		} else if (last_count > 0 && strcmp(source->line, last) == 0) {
+			/* print a duplicated line once, on its second occurrence */
+			if (++last_count == 2 && fputs(last, out) == EOF) {
+				bail_out(errno, "could not write line");
+			}
+		} else {
+			(void) strcpy(last, source->line);
+			last_count = 1;
+		}
+
+		if (fgets(source->line, sizeof source->line, source->file) == NULL) {
+			if (ferror(source->file)) {
+				bail_out(errno, "could not read run");
+			}
+			heap[0] = heap[--n];
+		}
+		heap_sift_down(heap, n, 0);
+	}
+
+	for (int i = 0; i < count; i++) {
+		(void) fclose(files[i]);
+	}
+}
+
+static void heap_sift_down(struct merge_source **heap, int count, int i) {
+	while (2 * i + 1 < count) {
+		int child = 2 * i + 1;
+		if (child + 1 < count && strcmp(heap[child + 1]->line, heap[child]->line) < 0) {
+			child++;
+		}
+		if (strcmp(heap[i]->line, heap[child]->line) <= 0) {
+			return;
+		}
+		struct merge_source *tmp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = tmp;
+		i = child;
+	}
+}
+
+static void print_duplicates(void) {
+	if (cmd_out.item_count > 0) {
+		spill_run();
+	}
+	/* merge the oldest runs into a new one until one pass is left */
+	while (runs.run_count > MERGE_WAYS) {
+		FILE *file;
+
+		if ((file = tmpfile()) == NULL) {
+			bail_out(errno, "could not create temporary file");
+		}
+		DEBUG("merge %d of %d runs\n", MERGE_WAYS, runs.run_count);
+		merge_runs(runs.files, MERGE_WAYS, file, 0);
+		runs.run_count -= MERGE_WAYS;
+		(void) memmove(runs.files, runs.files + MERGE_WAYS, runs.run_count * sizeof (FILE *));
+		if (fseek(file, 0, SEEK_SET) != 0) {
+			(void) fclose(file);
+			bail_out(errno, "could not rewind run");
+		}
+		add_run(file);
+	}
+	DEBUG("merge %d runs\n", runs.run_count);
+	merge_runs(runs.files, runs.run_count, stdout, 1);
+	runs.run_count = 0;
+	if (fflush(stdout) != 0) {
+		bail_out(errno, "could not flush stdout");
+	}
+}
+
 static void pipe_to_command(char *command) {
 	DEBUG("pipe_to_command %s\n", command);
 	// create arg list for command
@@ -260,10 +464,8 @@ static void pipe_to_command(char *command) {
 				bail_out(errno, "parent: could not open read pipe");			
 			}
 
-			for (int i =0; i < cmd_out.item_count; i++) {
-				if (fputs(cmd_out.items[i], write_stream) == EOF) {
-					bail_out(EXIT_FAILURE, "fputs failed");
-				}
+			if (lines_write(&cmd_out, write_stream) == EOF) {
+				bail_out(EXIT_FAILURE, "fwrite failed");
 			}
 
 			if (fclose(write_stream) != 0) {
@@ -283,23 +485,56 @@ static void pipe_to_command(char *command) {
  */
 int main(int argc, char **argv) {
 
+	int c;
+
 	if(argc > 0) {
 		progname = argv[0];
 	}
-	if (argc != 3) {
-		bail_out(EXIT_FAILURE, "Usage: %s \"command1\" \"command2\"", progname);		
+	while ((c = getopt(argc, argv, "m:")) != -1) {
+		char *endptr;
+		long budget;
+
+		switch (c) {
+			case 'm':
+				errno = 0;
+				budget = strtol(optarg, &endptr, 10);
+				if (endptr == optarg || *endptr != '\0' || errno != 0 ||
+					budget < MIN_BUDGET || budget > LONG_MAX / 1024) {
+					errno = 0;
+					bail_out(EXIT_FAILURE, "<budget> has to be at least %d KiB", MIN_BUDGET);
+				}
+				mem_budget = (size_t) budget * 1024;
+				break;
+			default:
+				bail_out(EXIT_FAILURE, "Usage: %s [-m <budget>] \"command1\" \"command2\"", progname);
+		}
+	}
+	if (argc - optind != 2) {
+		bail_out(EXIT_FAILURE, "Usage: %s [-m <budget>] \"command1\" \"command2\"", progname);		
 	}
 
-	bzero(&cmd_out, sizeof cmd_out);
-	pipe_from_command(argv[1]);
-	pipe_from_command(argv[2]);
+	/* chunks of a quarter of the budget, but large enough for a line */
+	size_t chunk_size = CHUNK_SIZE;
+	while (mem_budget != 0 && chunk_size > mem_budget / 4 && chunk_size > LINE_SIZE) {
+		chunk_size /= 2;
+	}
+	lines_init(&cmd_out, chunk_size);
+	bzero(&runs, sizeof runs);
+	pipe_from_command(argv[optind]);
+	pipe_from_command(argv[optind + 1]);
+
+	if (mem_budget != 0) {
+		print_duplicates();
+		free_resources();
+		return EXIT_SUCCESS;
+	}
 
 	// sort cmd output list
-	qsort(cmd_out.items, cmd_out.item_count, sizeof(char *), str_cmp_p);
+	lines_sort(&cmd_out);
 
 	DEBUG("### sorted command output ###\n");
 	for (int i = 0; i < cmd_out.item_count; i++) {
-		DEBUG("%d: %s", i, cmd_out.items[i]);
+		DEBUG("%d: %.*s", i, (int) cmd_out.items[i].length, lines_text(&cmd_out, &cmd_out.items[i]));
 	}
 	DEBUG("###\n");
 
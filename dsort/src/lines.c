@@ -0,0 +1,241 @@
+/**
+ * @file lines.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief line storage of dsort: the text of the lines in a chunked arena and a
+ * compact index of them
+ *
+ * @date 10.11.2015
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "lines.h"
+
+/* === Constants === */
+
+/**
+ * @brief partitions of up to this many lines are sorted by insertion
+ */
+#define SORT_SMALL (16)
+
+/* === Prototypes === */
+
+/** key prefix of a line
+ * @brief pack the first PREFIX_BYTES bytes of a line into an integer
+ * @param line The line
+ * @param length Length of the line
+ * @return The bytes big endian, zero padded
+ */
+static uint64_t line_prefix(const char *line, size_t length);
+
+/** compare two lines
+ * @brief compare the prefixes, then the text
+ * @param list The list of the lines
+ * @param a The first line
+ * @param b The second line
+ * @return < 0, 0 or > 0 like strcmp
+ */
+static inline int ref_cmp(const struct line_list *list, const struct line_ref *a,
+	const struct line_ref *b);
+
+/** sort lines
+ * @brief quicksort with a three-way partition, duplicated lines are common in
+ * dsort's input and end up in the middle part at once
+ * @param list The list of the lines
+ * @param items The lines to sort
+ * @param count Number of lines
+ */
+static void sort_refs(const struct line_list *list, struct line_ref *items, size_t count);
+
+/** swap two lines
+ * @brief exchange two entries of the index
+ * @param a The first entry
+ * @param b The second entry
+ */
+static inline void ref_swap(struct line_ref *a, struct line_ref *b);
+
+/* === Implementations === */
+
+void lines_init(struct line_list *list, size_t chunk_size) {
+	memset(list, 0, sizeof *list);
+	list->chunk_size = chunk_size;
+	while (((size_t) 1 << list->chunk_shift) < chunk_size) {
+		list->chunk_shift++;
+	}
+}
+
+int lines_add(struct line_list *list, const char *line, size_t length) {
+	struct line_ref *ref;
+
+	if (list->item_count == list->size) {
+		int size = list->size == 0 ? 1024 : list->size * 2;
+		struct line_ref *items = realloc(list->items, size * sizeof *items);
+		if (items == NULL) {
+			return -1;
+		}
+		list->allocs++;
+		list->items = items;
+		list->size = size;
+	}
+	/* a line does not span two chunks, the rest of a full one stays unused */
+	if (list->chunk_count == 0 || list->used + length > list->chunk_size) {
+		if (list->chunk_count != 0) {
+			list->chunk++;
+			list->used = 0;
+		}
+		if (list->chunk == list->chunk_count) {
+			if (list->chunk_count == list->chunk_slots) {
+				int slots = list->chunk_slots == 0 ? 8 : list->chunk_slots * 2;
+				char **chunks = realloc(list->chunks, slots * sizeof *chunks);
+				if (chunks == NULL) {
+					return -1;
+				}
+				list->allocs++;
+				list->chunks = chunks;
+				list->chunk_slots = slots;
+			}
+			if ((list->chunks[list->chunk_count] = malloc(list->chunk_size)) == NULL) {
+				return -1;
+			}
+			list->allocs++;
+			list->chunk_count++;
+		}
+	}
+
+	ref = &list->items[list->item_count++];
+	ref->prefix = line_prefix(line, length);
+	ref->offset = ((size_t) list->chunk << list->chunk_shift) + list->used;
+	ref->length = length;
+	(void) memcpy(list->chunks[list->chunk] + list->used, line, length);
+	list->used += length;
+	return 0;
+}
+
+void lines_sort(struct line_list *list) {
+	sort_refs(list, list->items, list->item_count);
+}
+
+int lines_write(const struct line_list *list, FILE *stream) {
+	for (int i = 0; i < list->item_count; i++) {
+		const struct line_ref *ref = &list->items[i];
+		if (fwrite(lines_text(list, ref), 1, ref->length, stream) != ref->length) {
+			return EOF;
+		}
+	}
+	return 0;
+}
+
+void lines_clear(struct line_list *list) {
+	list->item_count = 0;
+	list->chunk = 0;
+	list->used = 0;
+}
+
+void lines_free(struct line_list *list) {
+	for (int i = 0; i < list->chunk_count; i++) {
+		free(list->chunks[i]);
+	}
+	free(list->chunks);
+	free(list->items);
+	lines_init(list, list->chunk_size);
+}
+
+static uint64_t line_prefix(const char *line, size_t length) {
+	uint64_t prefix = 0;
+
+	if (length >= PREFIX_BYTES) {
+		(void) memcpy(&prefix, line, PREFIX_BYTES);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		prefix = __builtin_bswap64(prefix);
+#endif
+		return prefix;
+	}
+	for (int i = 0; i < PREFIX_BYTES; i++) {
+		prefix = (prefix << 8) | ((size_t) i < length ? (unsigned char) line[i] : 0);
+	}
+	return prefix;
+}
+
+static inline int ref_cmp(const struct line_list *list, const struct line_ref *a,
+	const struct line_ref *b) {
+	size_t n;
+	int ret;
+
+	if (a->prefix != b->prefix) {
+		return a->prefix < b->prefix ? -1 : 1;
+	}
+	/* the lines hold no zero bytes, so equal prefixes mean equal first
+		PREFIX_BYTES bytes and the text differs after them at the earliest */
+	n = a->length < b->length ? a->length : b->length;
+	if (n > PREFIX_BYTES) {
+		ret = memcmp(lines_text(list, a) + PREFIX_BYTES,
+			lines_text(list, b) + PREFIX_BYTES, n - PREFIX_BYTES);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+	return (a->length > b->length) - (a->length < b->length);
+}
+
+static void sort_refs(const struct line_list *list, struct line_ref *items, size_t count) {
+	while (count > SORT_SMALL) {
+		struct line_ref pivot;
+		size_t lt = 0, i = 0, gt = count;
+
+		/* median of the first, middle and last line, sorted input stays fast */
+		struct line_ref *mid = &items[count / 2];
+		struct line_ref *last = &items[count - 1];
+		if (ref_cmp(list, mid, items) < 0) {
+			ref_swap(mid, items);
+		}
+		if (ref_cmp(list, last, mid) < 0) {
+			ref_swap(last, mid);
+			if (ref_cmp(list, mid, items) < 0) {
+				ref_swap(mid, items);
+			}
+		}
+		pivot = *mid;
+
+		/* [0, lt) less, [lt, i) equal, [gt, count) greater than the pivot */
+		while (i < gt) {
+			int ret = ref_cmp(list, &items[i], &pivot);
+			if (ret < 0) {
+				ref_swap(&items[lt++], &items[i++]);
+			} else if (ret > 0) {
+				ref_swap(&items[i], &items[--gt]);
+			} else {
+				i++;
+			}
+		}
+
+		/* recurse into the smaller part, loop on the larger one */
+		if (lt < count - gt) {
+			sort_refs(list, items, lt);
+			items += gt;
+			count -= gt;
+		} else {
+			sort_refs(list, items + gt, count - gt);
+			count = lt;
+		}
+	}
+
+	for (size_t i = 1; i < count; i++) {
+		struct line_ref ref = items[i];
+		size_t j = i;
+		while (j > 0 && ref_cmp(list, &ref, &items[j - 1]) < 0) {
+			items[j] = items[j - 1];
+			j--;
+		}
+		items[j] = ref;
+	}
+}
+
+static inline void ref_swap(struct line_ref *a, struct line_ref *b) {
+	struct line_ref tmp = *a;
+
+	*a = *b;
+	*b = tmp;
+}
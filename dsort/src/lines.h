@@ -0,0 +1,129 @@
+/**
+ * @file lines.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief line storage of dsort: the text of the lines in a chunked arena and a
+ * compact index of them
+ *
+ * @details the lines are copied back to back into chunks of chunk_size bytes,
+						a line never spans two chunks. The index has one line_ref per line
+						with its position in the arena, its length and its first
+						PREFIX_BYTES as an integer, so sorting compares integers for most
+						pairs and only reads the arena for lines sharing their prefix.
+						All lines are dropped at once, the chunks are kept for the next ones.
+ *
+ * @date 10.11.2015
+ *
+ */
+#ifndef LINES_H
+#define LINES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* === Constants === */
+
+/**
+ * @brief number of leading bytes of a line kept in its line_ref
+ */
+#define PREFIX_BYTES (8)
+
+/**
+ * @brief default size of an arena chunk
+ */
+#define CHUNK_SIZE (1 << 20)
+
+/* === Type Definitions === */
+
+/** struct for a line in the index */
+struct line_ref {
+	/** first PREFIX_BYTES bytes, big endian and zero padded, compare like strcmp */
+	uint64_t prefix;
+	/** position of the text in the arena, chunk number << chunk_shift plus offset */
+	size_t offset;
+	/** length of the text, without terminating zero */
+	uint32_t length;
+};
+
+/** struct for a list of lines */
+struct line_list {
+	/** index of the lines */
+	struct line_ref *items;
+	/** size of the index */
+	int size;
+	/** current item count of the list */
+	int item_count;
+	/** chunks of the arena */
+	char **chunks;
+	/** chunks allocated */
+	int chunk_count;
+	/** size of the chunk table */
+	int chunk_slots;
+	/** chunk the next line goes to and bytes used in it */
+	int chunk;
+	size_t used;
+	/** size of a chunk, a power of two, and its logarithm */
+	size_t chunk_size;
+	int chunk_shift;
+	/** number of malloc and realloc calls so far */
+	unsigned long allocs;
+};
+
+/* === Prototypes === */
+
+/** initialize a list
+ * @brief set up an empty list
+ * @param list The list
+ * @param chunk_size Size of the arena chunks, a power of two of at least the
+ * longest line
+ */
+void lines_init(struct line_list *list, size_t chunk_size);
+
+/** add a line
+ * @brief copy a line into the arena and append it to the index
+ * @param list The list
+ * @param line The line
+ * @param length Length of the line, at most chunk_size
+ * @return 0 on success, -1 if memory is exhausted
+ */
+int lines_add(struct line_list *list, const char *line, size_t length);
+
+/** text of a line
+ * @brief look up the text of a line in the arena
+ * @param list The list
+ * @param ref The line
+ * @return The text, length bytes without terminating zero
+ */
+static inline const char *lines_text(const struct line_list *list, const struct line_ref *ref) {
+	return list->chunks[ref->offset >> list->chunk_shift] + (ref->offset & (list->chunk_size - 1));
+}
+
+/** sort a list
+ * @brief sort the index in the order of strcmp(3)
+ * @param list The list
+ */
+void lines_sort(struct line_list *list);
+
+/** write a list
+ * @brief write the lines in index order to a stream
+ * @param list The list
+ * @param stream The stream
+ * @return 0 on success, EOF on error
+ */
+int lines_write(const struct line_list *list, FILE *stream);
+
+/** empty a list
+ * @brief drop all lines, the arena chunks are kept for the next ones
+ * @param list The list
+ */
+void lines_clear(struct line_list *list);
+
+/** free a list
+ * @brief free the index and the arena in one go
+ * @param list The list
+ */
+void lines_free(struct line_list *list);
+
+#endif /* LINES_H */
@@ -0,0 +1,819 @@
+/**
+ *  mastermind: bench
+ *
+ *  @author Thomas Muhm 1326486
+ *
+ *  @brief benchmarks for the mastermind client and server internals
+ *
+ *  @details
+ *    bench score: checks the precomputed score tables and the SIMD kernels
+ *    against the per slot loops the server and the client used before and
+ *    compares their speed
+ *    bench solve: plays every secret in process with the solver against the
+ *    server's game rules, spread over threads, and reports the rounds
+ *    needed and the time per game. The first pass ranks every answer
+ *    history, the second one finds the guesses in the solver's cache. With
+ *    a code list file (see codelist.h) only its secrets are played
+ *    bench strategies: runs both passes of bench solve for every strategy
+ *    and compares the rounds needed, the wall time and the CPU time
+ *    bench decode: checks the batched request decoding and scoring of the
+ *    server (see game.h) against play_round() per request and compares
+ *    their throughput on frames of random requests of random games, one in
+ *    DECODE_BAD_PARITY of them with a wrong parity bit
+ *
+ *  @date 17.10.2015
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mastermind.h"
+#include "score.h"
+#include "solver.h"
+#include "tree.h"
+#include "game.h"
+#include "codelist.h"
+
+/* === Constants === */
+
+/* number of guesses scored against every code per benchmark */
+#define BENCH_GUESSES (CODES <= (1 << 16) ? 256 : 16)
+
+/* passes over all secrets of bench solve */
+#define SOLVE_PASSES (2)
+
+/* maximum number of threads of bench solve */
+#define SOLVE_MAX_THREADS (SOLVER_MAX_THREADS)
+
+/* requests of bench decode */
+#define DECODE_REQUESTS (1 << 20)
+
+/* one request in DECODE_BAD_PARITY has a wrong parity bit */
+#define DECODE_BAD_PARITY (64)
+
+/* passes over the requests per decode benchmark */
+#define DECODE_PASSES (8)
+
+/* === Macros === */
+
+/* Length of an array */
+#define COUNT_OF(x) (sizeof(x)/sizeof(x[0]))
+
+/* === Global Variables === */
+
+/* Name of the program */
+static const char *progname = "bench";
+
+/* guesses scored in the benchmarks */
+static code_t guesses[BENCH_GUESSES];
+
+/* scores of one row */
+static uint8_t row[CODES];
+
+/* === Type Definitions === */
+
+/* a benchmark command */
+struct command {
+    const char *name;
+    int (*run)(int argc, char **argv);
+};
+
+/* one pass of bench solve, shared by its threads */
+struct solve_pass {
+    enum solver_strategy strategy;
+    /* decision tree to follow, NULL to rank */
+    const struct tree *tree;
+    /* secrets to play, NULL for every valid code */
+    const code_t *secrets;
+    long count;
+    /* next secret to play, taken with atomic adds */
+    long next;
+    /* results, protected by lock */
+    pthread_mutex_t lock;
+    unsigned long histogram[MAX_TRIES + 1];
+    unsigned long won;
+    unsigned long total_rounds;
+    int max_rounds;
+};
+
+/* === Prototypes === */
+
+/**
+ * bench_score
+ * @brief Verify and time the score implementations
+ * @return EXIT_SUCCESS if all implementations agree, else EXIT_FAILURE
+ */
+static int bench_score(int argc, char **argv);
+
+/**
+ * bench_solve
+ * @brief Play every secret in process and report rounds and time per game
+ * @param argc Number of arguments
+ * @param argv Arguments: [strategy or tree file] [threads] [code list file]
+ * @return EXIT_SUCCESS if all games were won, else EXIT_FAILURE
+ */
+static int bench_solve(int argc, char **argv);
+
+/**
+ * bench_strategies
+ * @brief Play every secret with every strategy and compare rounds and time
+ * @param argc Number of arguments
+ * @param argv Arguments: [threads] [code list file]
+ * @return EXIT_SUCCESS if all games were won, else EXIT_FAILURE
+ */
+static int bench_strategies(int argc, char **argv);
+
+/**
+ * bench_decode
+ * @brief Verify and time the batched decoding and scoring of requests
+ * @return EXIT_SUCCESS if the batches agree with play_round(), else EXIT_FAILURE
+ */
+static int bench_decode(int argc, char **argv);
+
+/**
+ * report_requests
+ * @brief Print the time per request of a decode benchmark
+ * @param name Name of the implementation
+ * @param ns Elapsed nanoseconds
+ * @param checksum Sum of all answers, keeps the loops from being optimized away
+ */
+static void report_requests(const char *name, double ns, unsigned long checksum);
+
+/**
+ * parse_threads
+ * @brief Parse the number of threads of a benchmark
+ * @param arg The argument, NULL for the number of processors
+ * @return The number of threads, terminates the program on a bad argument
+ */
+static long parse_threads(const char *arg);
+
+/**
+ * run_pass
+ * @brief Play the secrets of a pass, spread over threads
+ * @param run The pass, strategy, tree, secrets and count have to be set
+ * @param threads Number of threads
+ * @param cpu Set to the CPU time the process spent in nanoseconds
+ * @return The elapsed wall time in nanoseconds
+ */
+static double run_pass(struct solve_pass *run, long threads, double *cpu);
+
+/**
+ * solve_worker
+ * @brief Thread function of bench solve, plays secrets until none are left
+ * @param arg The struct solve_pass
+ * @return NULL
+ */
+static void *solve_worker(void *arg);
+
+/**
+ * loop_score_server
+ * @brief Score with the per slot loops of the server's compute_answer()
+ * @param guess The encoded guess
+ * @param secret The encoded secret
+ * @return red | white << SCORE_WHITE_SHIFT
+ */
+static uint8_t loop_score_server(code_t guess, code_t secret);
+
+/**
+ * loop_score_client
+ * @brief Score with the per slot loops of the client's knuth_remove_sol()
+ * @param guess The encoded guess
+ * @param sol The encoded solution
+ * @return red | white << SCORE_WHITE_SHIFT
+ */
+static uint8_t loop_score_client(code_t guess, code_t sol);
+
+/**
+ * now
+ * @brief Read the monotonic clock
+ * @return Time in nanoseconds
+ */
+static double now(void);
+
+/**
+ * cpu_now
+ * @brief Read the CPU time clock of the process
+ * @return Time in nanoseconds
+ */
+static double cpu_now(void);
+
+/**
+ * report
+ * @brief Print the time per score of a benchmark
+ * @param name Name of the implementation
+ * @param ns Elapsed nanoseconds
+ * @param scores Number of scores computed
+ * @param checksum Sum of all scores, keeps the loops from being optimized away
+ */
+static void report(const char *name, double ns, unsigned long scores, unsigned long checksum);
+
+/**
+ * bail_out
+ * @brief terminate program on program error
+ * @param exitcode exit code
+ * @param fmt format string
+ */
+static void bail_out(int exitcode, const char *fmt, ...);
+
+/* === Implementations === */
+
+static const struct command commands[] = {
+    { "score", bench_score },
+    { "solve", bench_solve },
+    { "strategies", bench_strategies },
+    { "decode", bench_decode },
+};
+
+static int bench_score(int argc, char **argv)
+{
+    unsigned long checksum;
+    enum score_kernel kernel, best;
+    code_t *codes;
+    double start;
+    long s;
+    int g;
+
+    /* the valid codes, the secrets a game can have */
+    if ((codes = malloc(VALID_CODES * sizeof *codes)) == NULL) {
+        bail_out(EXIT_FAILURE, "malloc");
+    }
+    for (s = 0; s < VALID_CODES; s++) {
+        codes[s] = code_from_index(s);
+    }
+
+    /* verify every guess of the sample against every code */
+    for (g = 0; g < BENCH_GUESSES; g++) {
+        score_row(guesses[g], row);
+        for (s = 0; s < VALID_CODES; s++) {
+            uint8_t expected = loop_score_server(guesses[g], codes[s]);
+            if (score(guesses[g], codes[s]) != expected || row[codes[s]] != expected ||
+                loop_score_client(guesses[g], codes[s]) != expected) {
+                errno = 0;
+                bail_out(EXIT_FAILURE, "score mismatch for guess 0x%lx secret 0x%lx",
+                         (unsigned long) guesses[g], (unsigned long) codes[s]);
+            }
+        }
+    }
+    (void) printf("verified %d x %ld scores\n", BENCH_GUESSES, (long) VALID_CODES);
+
+    checksum = 0;
+    start = now();
+    for (g = 0; g < BENCH_GUESSES; g++) {
+        for (s = 0; s < VALID_CODES; s++) {
+            checksum += loop_score_server(guesses[g], codes[s]);
+        }
+    }
+    report("server loops", now() - start, (unsigned long) BENCH_GUESSES * VALID_CODES, checksum);
+
+    checksum = 0;
+    start = now();
+    for (g = 0; g < BENCH_GUESSES; g++) {
+        for (s = 0; s < VALID_CODES; s++) {
+            checksum += loop_score_client(guesses[g], codes[s]);
+        }
+    }
+    report("client loops", now() - start, (unsigned long) BENCH_GUESSES * VALID_CODES, checksum);
+
+    checksum = 0;
+    start = now();
+    for (g = 0; g < BENCH_GUESSES; g++) {
+        for (s = 0; s < VALID_CODES; s++) {
+            checksum += score(guesses[g], codes[s]);
+        }
+    }
+    report("score()", now() - start, (unsigned long) BENCH_GUESSES * VALID_CODES, checksum);
+
+    /* the full sweep with every kernel the CPU supports */
+    best = score_selected();
+    for (kernel = SCORE_KERNEL_SCALAR; kernel <= SCORE_KERNEL_AVX2; kernel++) {
+        char name[32];
+
+        if (score_select(kernel) < 0) {
+            (void) printf("%-14s not supported\n", score_kernel_name(kernel));
+            continue;
+        }
+        for (g = 0; g < BENCH_GUESSES; g++) {
+            score_row(guesses[g], row);
+            for (s = 0; s < VALID_CODES; s++) {
+                if (row[codes[s]] != score(guesses[g], codes[s])) {
+                    errno = 0;
+                    bail_out(EXIT_FAILURE, "%s: score mismatch for guess 0x%lx secret 0x%lx",
+                             score_kernel_name(kernel), (unsigned long) guesses[g],
+                             (unsigned long) codes[s]);
+                }
+            }
+        }
+
+        checksum = 0;
+        start = now();
+        for (g = 0; g < BENCH_GUESSES; g++) {
+            score_row(guesses[g], row);
+            checksum += row[guesses[g]];
+        }
+        (void) snprintf(name, sizeof name, "row %s", score_kernel_name(kernel));
+        report(name, now() - start, (unsigned long) BENCH_GUESSES * VALID_CODES, checksum);
+    }
+    (void) score_select(best);
+    free(codes);
+    return EXIT_SUCCESS;
+}
+
+static int bench_solve(int argc, char **argv)
+{
+    static struct tree tree;
+    static struct codelist list;
+    enum solver_strategy strategy = SOLVER_DEFAULT;
+    long count;
+    int ret = EXIT_SUCCESS;
+
+    if (argc > 3) {
+        bail_out(EXIT_FAILURE, "Usage: %s solve [<strategy>|<tree-file>] [<threads>] [<code-file>]",
+                 progname);
+    }
+    if (argc > 0 && solver_strategy_parse(argv[0], &strategy) != 0 &&
+        tree_open(argv[0], &tree) != 0) {
+        bail_out(EXIT_FAILURE, "%s is neither a strategy nor a decision tree", argv[0]);
+    }
+    count = parse_threads(argc > 1 ? argv[1] : NULL);
+    if (argc > 2 && codelist_open(argv[2], &list) != 0) {
+        bail_out(EXIT_FAILURE, "Could not load code list %s", argv[2]);
+    }
+    /* the games run in parallel, so every thread ranks its own guesses */
+    if (solver_setup(1) != 0) {
+        bail_out(EXIT_FAILURE, "solver_setup");
+    }
+
+    for (int pass = 1; pass <= SOLVE_PASSES; pass++) {
+        struct solve_pass run;
+        double ns, cpu;
+
+        (void) memset(&run, 0, sizeof run);
+        run.strategy = strategy;
+        run.tree = tree.header != NULL ? &tree : NULL;
+        run.secrets = list.codes;
+        run.count = list.header != NULL ? (long) list.count : VALID_CODES;
+        ns = run_pass(&run, count, &cpu);
+
+        if (pass == 1) {
+            for (int i = 1; i <= MAX_TRIES; i++) {
+                if (run.histogram[i] > 0) {
+                    (void) printf("Runden %d: %lu\n", i, run.histogram[i]);
+                }
+            }
+            (void) printf("Games won: %lu/%ld, max Runden %d, avg Runden %.3f\n",
+                          run.won, run.count, run.max_rounds,
+                          run.won > 0 ? (double) run.total_rounds / run.won : 0.0);
+        }
+        (void) printf("%s pass %d: %ld threads, %10.1f ms, %10.1f ms cpu, %10.0f ns/game\n",
+                      run.tree != NULL ? argv[0] : solver_strategy_name(strategy),
+                      pass, count, ns / 1e6, cpu / 1e6, ns / run.count);
+        if (run.won != (unsigned long) run.count) {
+            ret = EXIT_FAILURE;
+        }
+    }
+
+    solver_shutdown();
+    tree_close(&tree);
+    codelist_close(&list);
+    return ret;
+}
+
+static int bench_strategies(int argc, char **argv)
+{
+    static struct codelist list;
+    long count;
+    int ret = EXIT_SUCCESS;
+
+    if (argc > 2) {
+        bail_out(EXIT_FAILURE, "Usage: %s strategies [<threads>] [<code-file>]", progname);
+    }
+    count = parse_threads(argc > 0 ? argv[0] : NULL);
+    if (argc > 1 && codelist_open(argv[1], &list) != 0) {
+        bail_out(EXIT_FAILURE, "Could not load code list %s", argv[1]);
+    }
+    if (solver_setup(1) != 0) {
+        bail_out(EXIT_FAILURE, "solver_setup");
+    }
+
+    (void) printf("%ld secrets, %ld threads, times in ms (cold: ranking every "
+                  "history, cached: solver cache filled)\n",
+                  list.header != NULL ? (long) list.count : (long) VALID_CODES, count);
+    (void) printf("%-10s %10s %5s %10s %10s %10s %10s\n", "strategy", "avg rounds", "max",
+                  "cold wall", "cold cpu", "cache wall", "cache cpu");
+    for (int s = 0; s < SOLVER_STRATEGIES; s++) {
+        double ns[SOLVE_PASSES], cpu[SOLVE_PASSES];
+        struct solve_pass run;
+
+        if (!solver_strategy_available(s)) {
+            continue;
+        }
+        for (int pass = 0; pass < SOLVE_PASSES; pass++) {
+            (void) memset(&run, 0, sizeof run);
+            run.strategy = s;
+            run.secrets = list.codes;
+            run.count = list.header != NULL ? (long) list.count : VALID_CODES;
+            ns[pass] = run_pass(&run, count, &cpu[pass]);
+            if (run.won != (unsigned long) run.count) {
+                ret = EXIT_FAILURE;
+            }
+        }
+        (void) printf("%-10s %10.3f %5d %10.1f %10.1f %10.1f %10.1f",
+                      solver_strategy_name(s),
+                      run.won > 0 ? (double) run.total_rounds / run.won : 0.0, run.max_rounds,
+                      ns[0] / 1e6, cpu[0] / 1e6, ns[1] / 1e6, cpu[1] / 1e6);
+        if (run.won != (unsigned long) run.count) {
+            (void) printf(" (lost %lu)", (unsigned long) run.count - run.won);
+        }
+        (void) printf("\n");
+    }
+
+    solver_shutdown();
+    codelist_close(&list);
+    return ret;
+}
+
+static int bench_decode(int argc, char **argv)
+{
+    const unsigned long requests = (unsigned long) DECODE_REQUESTS * DECODE_PASSES;
+    uint8_t *frames, *entries, *rounds, *errors, *expected, *answers;
+    code_t *secrets, *codes;
+    unsigned long checksum;
+    double start;
+    long i;
+
+    frames = malloc(DECODE_REQUESTS * GUESS_BYTES);
+    entries = malloc(DECODE_REQUESTS * SESSION_REQ_BYTES);
+    rounds = malloc(DECODE_REQUESTS);
+    errors = malloc(DECODE_REQUESTS);
+    expected = malloc(DECODE_REQUESTS);
+    answers = malloc(DECODE_REQUESTS);
+    secrets = malloc(DECODE_REQUESTS * sizeof *secrets);
+    codes = malloc(DECODE_REQUESTS * sizeof *codes);
+    if (frames == NULL || entries == NULL || rounds == NULL || errors == NULL ||
+        expected == NULL || answers == NULL || secrets == NULL || codes == NULL) {
+        bail_out(EXIT_FAILURE, "malloc");
+    }
+
+    /* the guesses as FRAME_GUESSES and as FRAME_PLAY entries, every one of
+       another game */
+    for (i = 0; i < DECODE_REQUESTS; i++) {
+        code_t guess = code_from_index(rand() % VALID_CODES);
+        int parity = code_parity(guess) ^ (rand() % DECODE_BAD_PARITY == 0);
+
+        guess |= (code_t) parity << PARITY_BIT;
+        put_code(frames + i * GUESS_BYTES, guess);
+        put16(entries + i * SESSION_REQ_BYTES, i);
+        put_code(entries + i * SESSION_REQ_BYTES + 2, guess);
+        secrets[i] = code_from_index(rand() % VALID_CODES);
+        rounds[i] = 1 + rand() % MAX_TRIES;
+        (void) play_round(rounds[i], guess, &expected[i], secrets[i]);
+    }
+
+    /* many games: both layouts, one round of a game per request */
+    for (int layout = 0; layout < 2; layout++) {
+        if (layout == 0) {
+            game_decode(frames, GUESS_BYTES, DECODE_REQUESTS, codes, errors);
+        } else {
+            game_decode(entries + 2, SESSION_REQ_BYTES, DECODE_REQUESTS, codes, errors);
+        }
+        game_answers(secrets, rounds, codes, errors, DECODE_REQUESTS, answers);
+        for (i = 0; i < DECODE_REQUESTS; i++) {
+            if (answers[i] != expected[i]) {
+                errno = 0;
+                bail_out(EXIT_FAILURE, "game_answers mismatch for request %ld", i);
+            }
+        }
+    }
+    /* one game: the rounds of a frame, up to the last one */
+    game_decode(frames, GUESS_BYTES, DECODE_REQUESTS, codes, errors);
+    for (i = 0; i + MAX_TRIES <= DECODE_REQUESTS; i += MAX_TRIES) {
+        int round = 1 + (i / MAX_TRIES) % MAX_TRIES;
+
+        game_rounds(secrets[i], round, codes + i, errors + i, MAX_TRIES - round + 1, answers);
+        for (int r = round; r <= MAX_TRIES; r++) {
+            uint8_t answer;
+
+            (void) play_round(r, get_code(frames + (i + r - round) * GUESS_BYTES), &answer,
+                              secrets[i]);
+            if (answers[r - round] != answer) {
+                errno = 0;
+                bail_out(EXIT_FAILURE, "game_rounds mismatch for request %ld", i + r - round);
+            }
+        }
+    }
+    (void) printf("verified %d requests\n", DECODE_REQUESTS);
+
+    checksum = 0;
+    start = now();
+    for (int pass = 0; pass < DECODE_PASSES; pass++) {
+        for (i = 0; i < DECODE_REQUESTS; i++) {
+            uint8_t answer;
+
+            (void) play_round(rounds[i], get_code(frames + i * GUESS_BYTES), &answer, secrets[i]);
+            checksum += answer;
+        }
+    }
+    report_requests("play_round()", now() - start, checksum);
+
+    checksum = 0;
+    start = now();
+    for (int pass = 0; pass < DECODE_PASSES; pass++) {
+        game_decode(frames, GUESS_BYTES, DECODE_REQUESTS, codes, errors);
+        checksum += codes[pass] + errors[pass];
+    }
+    report_requests("decode", now() - start, checksum);
+
+    checksum = 0;
+    start = now();
+    for (int pass = 0; pass < DECODE_PASSES; pass++) {
+        game_decode(entries + 2, SESSION_REQ_BYTES, DECODE_REQUESTS, codes, errors);
+        checksum += codes[pass] + errors[pass];
+    }
+    report_requests("decode entries", now() - start, checksum);
+
+    /* the server's path for FRAME_PLAY, a full frame at a time */
+    checksum = 0;
+    start = now();
+    for (int pass = 0; pass < DECODE_PASSES; pass++) {
+        for (i = 0; i < DECODE_REQUESTS; i += FRAME_MAX_COUNT) {
+            game_decode(entries + i * SESSION_REQ_BYTES + 2, SESSION_REQ_BYTES,
+                        FRAME_MAX_COUNT, codes, errors);
+            game_answers(secrets + i, rounds + i, codes, errors, FRAME_MAX_COUNT, answers);
+            checksum += answers[0];
+        }
+    }
+    report_requests("batch games", now() - start, checksum);
+
+    /* the server's path for FRAME_GUESSES, the rounds of one game */
+    checksum = 0;
+    start = now();
+    for (int pass = 0; pass < DECODE_PASSES; pass++) {
+        for (i = 0; i + MAX_TRIES <= DECODE_REQUESTS; i += MAX_TRIES) {
+            game_decode(frames + i * GUESS_BYTES, GUESS_BYTES, MAX_TRIES, codes, errors);
+            game_rounds(secrets[i], 1, codes, errors, MAX_TRIES, answers);
+            checksum += answers[0];
+        }
+    }
+    report_requests("batch rounds", now() - start, checksum);
+
+    (void) printf("%lu requests per benchmark\n", requests);
+    free(frames);
+    free(entries);
+    free(rounds);
+    free(errors);
+    free(expected);
+    free(answers);
+    free(secrets);
+    free(codes);
+    return EXIT_SUCCESS;
+}
+
+static long parse_threads(const char *arg)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (arg != NULL) {
+        char *endptr;
+        count = strtol(arg, &endptr, 10);
+        if (endptr == arg || *endptr != '\0' || count < 1 || count > SOLVE_MAX_THREADS) {
+            errno = 0;
+            bail_out(EXIT_FAILURE, "<threads> has to be in range 1-%d", SOLVE_MAX_THREADS);
+        }
+    }
+    if (count < 1) {
+        count = 1;
+    }
+    if (count > SOLVE_MAX_THREADS) {
+        count = SOLVE_MAX_THREADS;
+    }
+    return count;
+}
+
+static double run_pass(struct solve_pass *run, long threads, double *cpu)
+{
+    pthread_t ids[SOLVE_MAX_THREADS];
+    double start, cpu_start, ns;
+
+    if (pthread_mutex_init(&run->lock, NULL) != 0) {
+        bail_out(EXIT_FAILURE, "pthread_mutex_init");
+    }
+    start = now();
+    cpu_start = cpu_now();
+    for (int i = 0; i < threads; i++) {
+        if ((errno = pthread_create(&ids[i], NULL, solve_worker, run)) != 0) {
+            bail_out(EXIT_FAILURE, "pthread_create");
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        (void) pthread_join(ids[i], NULL);
+    }
+    ns = now() - start;
+    *cpu = cpu_now() - cpu_start;
+    (void) pthread_mutex_destroy(&run->lock);
+    return ns;
+}
+
+static void *solve_worker(void *arg)
+{
+    struct solve_pass *run = arg;
+    struct solver *solver;
+    unsigned long histogram[MAX_TRIES + 1];
+    unsigned long won = 0, total_rounds = 0;
+    int max_rounds = 0;
+    long next;
+
+    if ((solver = malloc(sizeof *solver)) == NULL) {
+        bail_out(EXIT_FAILURE, "malloc");
+    }
+    (void) memset(histogram, 0, sizeof histogram);
+
+    while ((next = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED)) < run->count) {
+        code_t secret = run->secrets != NULL ? run->secrets[next] : code_from_index(next);
+        int status = GAME_RUNNING;
+
+        solver_init(solver, run->strategy);
+        if (run->tree != NULL) {
+            solver_follow(solver, run->tree);
+        }
+        for (int round = 1; status == GAME_RUNNING; round++) {
+            uint8_t answer;
+            int correct_guesses = play_round(round, solver_next_guess(solver), &answer, secret);
+
+            status = game_status(answer, correct_guesses);
+            if (status == GAME_RUNNING) {
+                solver_update(solver, answer);
+            }
+        }
+        if (status == EXIT_SUCCESS) {
+            won++;
+            total_rounds += solver->rounds;
+            histogram[solver->rounds]++;
+            if (solver->rounds > max_rounds) {
+                max_rounds = solver->rounds;
+            }
+        }
+    }
+
+    (void) pthread_mutex_lock(&run->lock);
+    for (int i = 0; i <= MAX_TRIES; i++) {
+        run->histogram[i] += histogram[i];
+    }
+    run->won += won;
+    run->total_rounds += total_rounds;
+    if (max_rounds > run->max_rounds) {
+        run->max_rounds = max_rounds;
+    }
+    (void) pthread_mutex_unlock(&run->lock);
+    free(solver);
+    return NULL;
+}
+
+static uint8_t loop_score_server(code_t guess, code_t secret)
+{
+    int colors_left[COLORS];
+    uint8_t g[SLOTS], s[SLOTS];
+    int red, white;
+    int j;
+
+    code_to_slots(guess, g);
+    code_to_slots(secret, s);
+
+    (void) memset(&colors_left[0], 0, sizeof(colors_left));
+    red = white = 0;
+    for (j = 0; j < SLOTS; ++j) {
+        /* mark red */
+        if (g[j] == s[j]) {
+            red++;
+        } else {
+            colors_left[s[j]]++;
+        }
+    }
+    for (j = 0; j < SLOTS; ++j) {
+        /* not marked red */
+        if (g[j] != s[j]) {
+            if (colors_left[g[j]] > 0) {
+                white++;
+                colors_left[g[j]]--;
+            }
+        }
+    }
+    return red | (white << SCORE_WHITE_SHIFT);
+}
+
+static uint8_t loop_score_client(code_t guess, code_t sol)
+{
+    int red = 0, white = 0;
+    int colors_left[COLORS];
+
+    (void) memset(&colors_left[0], 0, sizeof(colors_left));
+    for (int j = 0; j < SLOTS; j++) {
+        int guess_color = (guess >> (j * SHIFT_WIDTH)) & SLOT_MASK;
+        int sol_color = (sol >> (j * SHIFT_WIDTH)) & SLOT_MASK;
+        if (guess_color == sol_color) {
+            red++;
+        } else {
+            colors_left[guess_color]++;
+        }
+    }
+    for (int j = 0; j < SLOTS; j++) {
+        int guess_color = (guess >> (j * SHIFT_WIDTH)) & SLOT_MASK;
+        int sol_color = (sol >> (j * SHIFT_WIDTH)) & SLOT_MASK;
+        if (guess_color != sol_color) {
+            if (colors_left[sol_color] > 0) {
+                white++;
+                colors_left[sol_color]--;
+            }
+        }
+    }
+    return red | (white << SCORE_WHITE_SHIFT);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double cpu_now(void)
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *name, double ns, unsigned long scores, unsigned long checksum)
+{
+    (void) printf("%-14s %8.2f ns/score %10.1f ms (checksum %lu)\n",
+                  name, ns / scores, ns / 1e6, checksum);
+}
+
+static void report_requests(const char *name, double ns, unsigned long checksum)
+{
+    (void) printf("%-14s %8.2f ns/request %8.1f M requests/s (checksum %lu)\n", name,
+                  ns / ((double) DECODE_REQUESTS * DECODE_PASSES),
+                  (double) DECODE_REQUESTS * DECODE_PASSES / ns * 1e3, checksum);
+}
+
+static void bail_out(int exitcode, const char *fmt, ...)
+{
+    va_list ap;
+
+    (void) fprintf(stderr, "%s: ", progname);
+    if (fmt != NULL) {
+        va_start(ap, fmt);
+        (void) vfprintf(stderr, fmt, ap);
+        va_end(ap);
+    }
+    if (errno != 0) {
+        (void) fprintf(stderr, ": %s", strerror(errno));
+    }
+    (void) fprintf(stderr, "\n");
+    exit(exitcode);
+}
+
+/**
+ * main
+ * @brief Program entry point
+ * @param argc The argument counter
+ * @param argv The argument vector
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE on error
+ */
+int main(int argc, char *argv[])
+{
+    if (argc > 0) {
+        progname = argv[0];
+    }
+    if (argc < 2) {
+        bail_out(EXIT_FAILURE,
+                 "Usage: %s score | solve [<strategy>|<tree-file>] [<threads>] [<code-file>] | "
+                 "strategies [<threads>] [<code-file>] | decode\n<strategy>: %s",
+                 progname, solver_strategy_list());
+    }
+
+    score_init();
+
+    /* fixed seed, so runs are comparable */
+    srand(1);
+    for (int i = 0; i < BENCH_GUESSES; i++) {
+        guesses[i] = code_from_index(rand() % VALID_CODES);
+    }
+
+    for (int i = 0; i < COUNT_OF(commands); i++) {
+        if (strcmp(argv[1], commands[i].name) == 0) {
+            return commands[i].run(argc - 2, argv + 2);
+        }
+    }
+    bail_out(EXIT_FAILURE, "Unknown benchmark '%s'", argv[1]);
+    return EXIT_FAILURE;
+}
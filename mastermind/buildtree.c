@@ -0,0 +1,262 @@
+/**
+ *  mastermind: buildtree
+ *
+ *  @author Thomas Muhm 1326486
+ *
+ *  @brief writes the decision tree of a solver strategy to a file
+ *
+ *  @details
+ *    plays every answer the remaining candidates can give, depth first,
+ *    and stores the guess of the solver for every answer history. The
+ *    client follows the written tree with -t. The tree does not depend on
+ *    the secret, so it is built once per strategy
+ *
+ *  @date 17.10.2015
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "mastermind.h"
+#include "score.h"
+#include "solver.h"
+#include "tree.h"
+
+/* === Global Variables === */
+
+/* Name of the program */
+static const char *progname = "buildtree";
+
+/* nodes built so far */
+static struct tree_node *nodes;
+static uint32_t node_count;
+static uint32_t node_capacity;
+
+/* games won at a node and the rounds they needed */
+static unsigned long games;
+static unsigned long total_rounds;
+static unsigned long histogram[MAX_TRIES + 1];
+static int max_rounds;
+
+/* === Prototypes === */
+
+/**
+ * expand
+ * @brief Fill a node and build its children
+ * @param index Index of the node
+ * @param solver Solver after the answers leading to the node
+ * @param round Round of the node's guess
+ */
+static void expand(uint32_t index, struct solver *solver, int round);
+
+/**
+ * add_nodes
+ * @brief Append nodes to the tree
+ * @param count Number of nodes
+ * @return Index of the first new node
+ */
+static uint32_t add_nodes(uint32_t count);
+
+/**
+ * write_tree
+ * @brief Write the tree file
+ * @param path The file
+ * @param strategy Strategy the tree was built with
+ */
+static void write_tree(const char *path, enum solver_strategy strategy);
+
+/**
+ * usage
+ * @brief Print the usage and terminate
+ */
+static void usage(void);
+
+/**
+ * bail_out
+ * @brief terminate program on program error
+ * @param exitcode exit code
+ * @param fmt format string
+ */
+static void bail_out(int exitcode, const char *fmt, ...);
+
+/* === Implementations === */
+
+static void expand(uint32_t index, struct solver *solver, int round)
+{
+    code_t guess = solver->guess;
+    uint64_t children = 0;
+    uint32_t first;
+    int i = 0;
+
+    if (round > MAX_TRIES) {
+        errno = 0;
+        bail_out(EXIT_FAILURE, "%s needs more than %d rounds",
+                 solver_strategy_name(solver->strategy), MAX_TRIES);
+    }
+    if (candidates_contains(&solver->candidates, guess)) {
+        games++;
+        total_rounds += round;
+        histogram[round]++;
+        if (round > max_rounds) {
+            max_rounds = round;
+        }
+    }
+    (void) solver_next_guess(solver);
+
+    /* answers the remaining candidates can give, the won answer ends the game */
+    for (int w = 0; w < CANDIDATE_WORDS; w++) {
+        for (uint64_t bits = solver->candidates.bits[w]; bits != 0; bits &= bits - 1) {
+            children |= (uint64_t) 1 << score(guess, w * CANDIDATE_WORD_BITS + __builtin_ctzll(bits));
+        }
+    }
+
+    first = add_nodes(__builtin_popcountll(children));
+    nodes[index].guess = guess;
+    nodes[index].children = children;
+    nodes[index].first = first;
+
+    for (uint64_t bits = children; bits != 0; bits &= bits - 1) {
+        struct solver child = *solver;
+
+        solver_update(&child, __builtin_ctzll(bits));
+        expand(first + i++, &child, round + 1);
+    }
+}
+
+static uint32_t add_nodes(uint32_t count)
+{
+    uint32_t first = node_count;
+
+    if (node_count + count > node_capacity) {
+        uint32_t capacity = node_capacity > 0 ? node_capacity : 1024;
+        struct tree_node *grown;
+
+        while (node_count + count > capacity) {
+            capacity *= 2;
+        }
+        if ((grown = realloc(nodes, capacity * sizeof *nodes)) == NULL) {
+            bail_out(EXIT_FAILURE, "realloc");
+        }
+        nodes = grown;
+        node_capacity = capacity;
+    }
+    (void) memset(&nodes[first], 0, count * sizeof *nodes);
+    node_count += count;
+    return first;
+}
+
+static void write_tree(const char *path, enum solver_strategy strategy)
+{
+    struct tree_header header;
+    FILE *file;
+
+    (void) memset(&header, 0, sizeof header);
+    (void) memcpy(header.magic, TREE_MAGIC, sizeof header.magic);
+    header.version = TREE_VERSION;
+    header.slots = SLOTS;
+    header.colors = COLORS;
+    header.strategy = strategy;
+    header.byte_order = TREE_BYTE_ORDER;
+    header.nodes = node_count;
+
+    if ((file = fopen(path, "wb")) == NULL) {
+        bail_out(EXIT_FAILURE, "fopen %s", path);
+    }
+    if (fwrite(&header, sizeof header, 1, file) != 1 ||
+        fwrite(nodes, sizeof *nodes, node_count, file) != node_count) {
+        (void) fclose(file);
+        bail_out(EXIT_FAILURE, "fwrite %s", path);
+    }
+    if (fclose(file) != 0) {
+        bail_out(EXIT_FAILURE, "fclose %s", path);
+    }
+}
+
+static void usage(void)
+{
+    (void) fprintf(stderr, "Usage: %s [-s <strategy>] <tree-file>\n<strategy>: %s\n", progname,
+                   solver_strategy_list());
+    exit(EXIT_FAILURE);
+}
+
+static void bail_out(int exitcode, const char *fmt, ...)
+{
+    va_list ap;
+
+    (void) fprintf(stderr, "%s: ", progname);
+    if (fmt != NULL) {
+        va_start(ap, fmt);
+        (void) vfprintf(stderr, fmt, ap);
+        va_end(ap);
+    }
+    if (errno != 0) {
+        (void) fprintf(stderr, ": %s", strerror(errno));
+    }
+    (void) fprintf(stderr, "\n");
+    exit(exitcode);
+}
+
+/**
+ * main
+ * @brief Program entry point
+ * @param argc The argument counter
+ * @param argv The argument vector
+ * @return EXIT_SUCCESS on success, else EXIT_FAILURE
+ */
+int main(int argc, char *argv[])
+{
+    enum solver_strategy strategy = SOLVER_DEFAULT;
+    static struct solver solver;
+    int c;
+
+    if (argc > 0) {
+        progname = argv[0];
+    }
+    while ((c = getopt(argc, argv, "s:")) != -1) {
+        switch (c) {
+        case 's':
+            if (solver_strategy_parse(optarg, &strategy) != 0) {
+                usage();
+            }
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind != 1) {
+        usage();
+    }
+
+    score_init();
+    if (solver_setup(0) != 0) {
+        bail_out(EXIT_FAILURE, "solver_setup");
+    }
+
+    solver_init(&solver, strategy);
+    expand(add_nodes(1), &solver, 1);
+    if (games != VALID_CODES) {
+        errno = 0;
+        bail_out(EXIT_FAILURE, "tree solves %lu of %ld secrets", games, (long) VALID_CODES);
+    }
+    write_tree(argv[optind], strategy);
+
+    for (int i = 1; i <= MAX_TRIES; i++) {
+        if (histogram[i] > 0) {
+            (void) printf("Runden %d: %lu\n", i, histogram[i]);
+        }
+    }
+    (void) printf("%s: %u nodes, %lu bytes, max Runden %d, avg Runden %.3f\n",
+                  solver_strategy_name(strategy), node_count,
+                  (unsigned long) (sizeof(struct tree_header) + node_count * sizeof *nodes),
+                  max_rounds, (double) total_rounds / games);
+
+    solver_shutdown();
+    free(nodes);
+    return EXIT_SUCCESS;
+}
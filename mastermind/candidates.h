@@ -0,0 +1,234 @@
+/**
+ * @file candidates.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief set of the codes that may still be the secret
+ *
+ * @details
+ *    one bit per code, CODES / 64 words of 64 bits (4 KiB for 5x8), so the
+ *    whole state of a solver fits into the L1 cache. Codes with a slot
+ *    value >= COLORS are never candidates. Counting uses popcount,
+ *    searching skips words without any candidate and finds the bit with
+ *    clz
+ *
+ *    once no more than CANDIDATE_DENSE_MAX candidates are left they are
+ *    also kept in a dense array in ascending order. From then on filtering
+ *    scores only the survivors and compacts the array in place without
+ *    branches, so a round costs in proportion to the candidates left
+ *    instead of the whole code space. The bits are kept exact as well
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef CANDIDATES_H
+#define CANDIDATES_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "mastermind.h"
+#include "score.h"
+
+/* === Constants === */
+
+/** codes per word of the set */
+#define CANDIDATE_WORD_BITS (64)
+
+/** number of words of the set */
+#define CANDIDATE_WORDS (CODES / CANDIDATE_WORD_BITS)
+
+/** largest number of candidates kept in the dense array */
+#define CANDIDATE_DENSE_MAX (4096)
+
+/* === Type Definitions === */
+
+/** bit i % 64 of word i / 64 is set while code i is a candidate */
+struct candidates {
+    uint64_t bits[CANDIDATE_WORDS];
+    /* number of candidates in dense, -1 while there are too many */
+    int count;
+    /* the candidates in ascending order */
+    code_t dense[CANDIDATE_DENSE_MAX];
+};
+
+/* === Functions === */
+
+/**
+ * candidates_fill
+ * @brief Make every valid code a candidate
+ * @param set The set
+ */
+static inline void candidates_fill(struct candidates *set)
+{
+    (void) memcpy(set->bits, score_valid, sizeof set->bits);
+    set->count = -1;
+}
+
+/**
+ * candidates_remove
+ * @brief Remove a code from the set
+ * @param set The set
+ * @param code The code, bits above CODE_MASK are ignored
+ */
+static inline void candidates_remove(struct candidates *set, code_t code)
+{
+    uint64_t bit;
+
+    code &= CODE_MASK;
+    bit = (uint64_t) 1 << (code % CANDIDATE_WORD_BITS);
+    if ((set->bits[code / CANDIDATE_WORD_BITS] & bit) == 0) {
+        return;
+    }
+    set->bits[code / CANDIDATE_WORD_BITS] &= ~bit;
+    for (int i = 0; i < set->count; i++) {
+        if (set->dense[i] == code) {
+            set->count--;
+            (void) memmove(&set->dense[i], &set->dense[i + 1], (set->count - i) * sizeof *set->dense);
+            break;
+        }
+    }
+}
+
+/**
+ * candidates_contains
+ * @brief Test if a code is a candidate
+ * @param set The set
+ * @param code The code, bits above CODE_MASK are ignored
+ * @return 1 if the code is a candidate, else 0
+ */
+static inline int candidates_contains(const struct candidates *set, code_t code)
+{
+    code &= CODE_MASK;
+    return (set->bits[code / CANDIDATE_WORD_BITS] >> (code % CANDIDATE_WORD_BITS)) & 1;
+}
+
+/**
+ * candidates_count
+ * @brief Number of candidates
+ * @param set The set
+ * @return The number of codes in the set
+ */
+static inline int candidates_count(const struct candidates *set)
+{
+    int count = 0;
+
+    if (set->count >= 0) {
+        return set->count;
+    }
+    for (int w = 0; w < CANDIDATE_WORDS; w++) {
+        count += __builtin_popcountll(set->bits[w]);
+    }
+    return count;
+}
+
+/**
+ * candidates_first
+ * @brief Lowest candidate
+ * @param set The set
+ * @return The lowest code in the set, -1 if the set is empty
+ */
+static inline int candidates_first(const struct candidates *set)
+{
+    if (set->count >= 0) {
+        return set->count > 0 ? set->dense[0] : -1;
+    }
+    for (int w = 0; w < CANDIDATE_WORDS; w++) {
+        if (set->bits[w] != 0) {
+            return w * CANDIDATE_WORD_BITS + __builtin_ctzll(set->bits[w]);
+        }
+    }
+    return -1;
+}
+
+/**
+ * candidates_select
+ * @brief k-th lowest candidate
+ * @param set The set
+ * @param k Index of the candidate, from 0
+ * @return The code, -1 if the set has k or fewer codes
+ */
+static inline int candidates_select(const struct candidates *set, int k)
+{
+    if (set->count >= 0) {
+        return k < set->count ? set->dense[k] : -1;
+    }
+    for (int w = 0; w < CANDIDATE_WORDS; w++) {
+        uint64_t bits = set->bits[w];
+        int n = __builtin_popcountll(bits);
+
+        if (k >= n) {
+            k -= n;
+            continue;
+        }
+        /* clear the k lower bits of the word */
+        while (k-- > 0) {
+            bits &= bits - 1;
+        }
+        return w * CANDIDATE_WORD_BITS + __builtin_ctzll(bits);
+    }
+    return -1;
+}
+
+/**
+ * candidates_last
+ * @brief Highest candidate
+ * @param set The set
+ * @return The highest code in the set, -1 if the set is empty
+ */
+static inline int candidates_last(const struct candidates *set)
+{
+    if (set->count >= 0) {
+        return set->count > 0 ? set->dense[set->count - 1] : -1;
+    }
+    for (int w = CANDIDATE_WORDS - 1; w >= 0; w--) {
+        if (set->bits[w] != 0) {
+            return w * CANDIDATE_WORD_BITS + CANDIDATE_WORD_BITS - 1 - __builtin_clzll(set->bits[w]);
+        }
+    }
+    return -1;
+}
+
+/**
+ * candidates_filter
+ * @brief Remove the candidates contradicting the answer to a guess
+ * @param set The set
+ * @param guess The guess
+ * @param score The score (red and white pins) the server answered
+ */
+static inline void candidates_filter(struct candidates *set, code_t guess, uint8_t score)
+{
+    uint8_t scores[CANDIDATE_DENSE_MAX];
+    int n = set->count;
+
+    if (n < 0) {
+        /* sweep the whole code space, then switch to the dense array if it
+           is small enough */
+        score_filter(guess, score, set->bits);
+        if (candidates_count(set) > CANDIDATE_DENSE_MAX) {
+            return;
+        }
+        n = 0;
+        for (int w = 0; w < CANDIDATE_WORDS; w++) {
+            for (uint64_t bits = set->bits[w]; bits != 0; bits &= bits - 1) {
+                set->dense[n++] = w * CANDIDATE_WORD_BITS + __builtin_ctzll(bits);
+            }
+        }
+        set->count = n;
+        return;
+    }
+
+    score_codes(guess, set->dense, n, scores);
+    /* every code is written, only the survivors advance the end */
+    set->count = 0;
+    for (int i = 0; i < n; i++) {
+        code_t code = set->dense[i];
+        uint64_t gone = scores[i] != score;
+
+        set->bits[code / CANDIDATE_WORD_BITS] &= ~(gone << (code % CANDIDATE_WORD_BITS));
+        set->dense[set->count] = code;
+        set->count += !gone;
+    }
+}
+
+#endif /* CANDIDATES_H */
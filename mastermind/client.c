@@ -7,7 +7,40 @@
  *
  *  @details 
  *    client connects to the specified masermind server 
- *    uses the first steps from the knuth alorithem to solve the secret most of the time in under 8 steps
+ *    picks every guess with Knuth's minimax rule over all codes (see solver.h), with -s another
+ *    strategy of the solver can be chosen, with -t the guesses are looked up in a decision tree
+ *    written by buildtree
+ *    with -f the framed protocol (see mastermind.h) is negotiated instead of the legacy one
+ *    with -m the client plays the given number of games against the secrets 0, 1, ...
+ *    over one session connection and prints the distribution of the rounds needed
+ *    with -l the client generates load: it keeps the given number of non-blocking
+ *    connections busy from one epoll loop, every connection plays one game against
+ *    the server's secret and is replaced by a new one until -m games (default one
+ *    per connection) were played, then it prints games/s, the latency of the rounds
+ *    and the number of connection errors
+ *    with -k (implies -f) a load generator connection is kept alive: it starts every
+ *    game with FRAME_NEW, sent together with the first guess, and plays game after
+ *    game until -m games were started instead of reconnecting for each one
+ *    Nagle's algorithm is off for every connection, the small requests would
+ *    otherwise wait for the server's delayed ack
+ *    with -v the client tests itself without a server: it plays every secret (the
+ *    first -m ones) in process against the server's game rules, spread over -j
+ *    threads that steal ranges of secrets from each other once their own range is
+ *    done. Every guess goes through the same encoding as in a network game, the
+ *    run fails if a game is lost or answered with a parity error. The result is
+ *    printed as one line of JSON
+ *    with the <server-hostname> shm (or shm-poll) the client plays over the
+ *    shared memory region of a server started with -m on the same host
+ *    instead of a socket (see shmring.h): it sleeps on a futex while the
+ *    server computes an answer, shm-poll busy-polls. With -m it plays the
+ *    given number of games one after the other and prints games/s and the
+ *    latency of the rounds like the load generator
+ *    with -g (implies -f) the single game is started with FRAME_SAVE, the server
+ *    (started with -g) keeps it in its game table and the client prints the
+ *    game's token. When the connection drops, the client connects again, resumes
+ *    the game with FRAME_RESUME and rebuilds its solver from the rounds the server
+ *    played. If the server stays unreachable it exits with the token, -r <token>
+ *    resumes the game in a new client
  *
  *  @date 17.10.2015
  *
@@ -18,32 +51,61 @@
 #include <stdarg.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <errno.h>
 #include <limits.h>
 #include <unistd.h>
-#include <math.h>
 #include <stdbool.h>
 #include <string.h>
 #include <signal.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include "mastermind.h"
+#include "score.h"
+#include "solver.h"
+#include "histogram.h"
+#include "game.h"
+#include "shmring.h"
 
 /* === Constants === */
 
-#define SLOTS (5)
-#define COLORS (8)
 #define READ_BYTES (1)  
-#define WRITE_BYTES (2)
-#define BUFFER_BYTES (2)
-#define SHIFT_WIDTH (3)
-#define PARITY_BIT (15)
+#define WRITE_BYTES (GUESS_BYTES)
+#define BUFFER_BYTES (FRAME_HEADER_BYTES + WRITE_BYTES)
+
+/* a FRAME_NEW request or response followed by the first guess or answer */
+#define LOAD_BUFFER_BYTES (2 * BUFFER_BYTES)
+
+/* number of games played at the same time in session mode, each keeps a
+   candidate bit per code, so fewer for wide codes */
+#define SESSION_BATCH (CODES <= (1 << 16) ? 256 : 8)
+
+/* maximum number of connections of the load generator */
+#define LOAD_MAX_CONNECTIONS (65536)
+
+/* epoll events handled per wakeup of the load generator */
+#define LOAD_EVENTS (256)
+
+/* file descriptors besides the connections of the load generator */
+#define LOAD_SPARE_FDS (16)
+
+/* maximum number of self-test threads */
+#define VERIFY_MAX_THREADS (256)
 
-#define PARITY_ERR_BIT (6)
-#define GAME_LOST_ERR_BIT (7)
+/* <server-hostname> of the shared memory transport, sleeping or busy-polling */
+#define SHM_HOST "shm"
+#define SHM_POLL_HOST "shm-poll"
 
-#define EXIT_PARITY_ERROR (2)
-#define EXIT_GAME_LOST (3)
-#define EXIT_MULTIPLE_ERRORS (4)
+/* connection attempts after the connection of a resumable game dropped, the
+   pause before an attempt doubles from RESUME_PAUSE_MS */
+#define RESUME_ATTEMPTS (8)
+#define RESUME_PAUSE_MS (50)
 
 /* === Macros === */
 
@@ -66,15 +128,116 @@ static int sockfd = -1;
 
 static struct addrinfo *ai;
 
+/* shared memory region and the channel of the running game */
+static struct shm_region *shm = NULL;
+static struct shm_channel *shm_channel = NULL;
+
+/* decision tree given with -t */
+static struct tree tree;
+
 /* This variable is set upon receipt of a signal */
 volatile sig_atomic_t quit = 0;
 
-enum { beige = 0, darkblue, green, orange, red, black, violet, white };
-
 /* === Type Definitions === */
 struct opts {
   char *hostname;
+  char *port_arg;
   long int port;
+  bool framed;
+  /* keep load generator connections open between games */
+  bool keepalive;
+  /* number of games to play in session mode, 0 for a single game */
+  long int games;
+  enum solver_strategy strategy;
+  /* decision tree file, NULL to rank the guesses */
+  char *tree_path;
+  /* number of connections of the load generator, 0 to play normally */
+  long int connections;
+  /* test the solver in process instead of connecting */
+  bool verify;
+  /* threads of the self-test, 0 for one per online CPU */
+  long int threads;
+  /* play over the shared memory region of the port */
+  bool shm;
+  /* busy-poll for the answers instead of sleeping */
+  bool shm_poll;
+  /* save the game in the server's game table, resume it on a new connection */
+  bool resumable;
+  /* token of the saved game to resume, 0 to start a new one */
+  uint64_t token;
+};
+
+/* what a load generator connection waits for */
+enum load_state {
+  LOAD_CONNECTING,
+  LOAD_SENDING,
+  LOAD_RECEIVING
+};
+
+/* a connection of the load generator, playing one game */
+struct load_conn {
+  int fd;
+  enum load_state state;
+  /* epoll events the connection is registered for */
+  uint32_t events;
+  /* hello sent, waiting for the protocol version */
+  bool hello;
+  /* FRAME_NEW sent in front of the guess */
+  bool renew;
+  /* request being sent */
+  uint8_t out[LOAD_BUFFER_BYTES];
+  size_t outoff;
+  size_t outlen;
+  /* response being received */
+  uint8_t in[LOAD_BUFFER_BYTES];
+  size_t inoff;
+  size_t inlen;
+  /* time the request of the current round was started */
+  uint64_t sent;
+  struct solver solver;
+};
+
+/* state and results of the load generator */
+struct load {
+  int epfd;
+  const struct addrinfo *ai;
+  bool framed;
+  bool keepalive;
+  enum solver_strategy strategy;
+  /* games to play and games started so far */
+  long int games;
+  long int started;
+  /* connections not closed yet */
+  long int active;
+  unsigned long won;
+  unsigned long lost;
+  unsigned long parity_errors;
+  unsigned long errors;
+  /* latency of every round in ns, from the first byte sent to the answer */
+  struct histogram rounds;
+};
+
+/* a self-test thread, its secrets are the indices [next, end) of its
+   range, packed as end << 32 | next so that the owner taking the next
+   secret and a thief taking the upper half are single compare and swaps */
+struct verify_worker {
+  uint64_t range;
+  struct verify *verify;
+  int index;
+  pthread_t thread;
+  /* results */
+  unsigned long histogram[MAX_TRIES + 1];
+  unsigned long won;
+  unsigned long lost;
+  unsigned long parity_errors;
+  unsigned long steals;
+} __attribute__((aligned(64)));
+
+/* state of the self-test */
+struct verify {
+  enum solver_strategy strategy;
+  int threads;
+  struct verify_worker *workers;
 };
 
 /* === Prototypes === */
@@ -114,14 +277,228 @@ static uint8_t *read_from_server(int sockfd, uint8_t *buffer, size_t n);
 static int write_to_server(int sockfd, uint8_t *buffer, size_t n);
 
 /**
- * knuth_remove_sol
- * @brief knuth alogrithm - remove impossible solutions
- * @param guess       The last guess
- * @param solutions   Solution array - each index represents a solution
- * @param red_guess   The number of red pins for the last guess
- * @param white_guess The number of red pins for the last guess
+ * negotiate_framed
+ * @brief Switch the connection to the framed protocol
+ * @param sockfd Connected socket, before the first guess was sent
+ * @return 0 on success and -1 on a connection error, terminates the
+ * program if the server only speaks the legacy protocol
+ */
+static int negotiate_framed(int sockfd);
+
+/**
+ * save_game
+ * @brief Start the connection's game with FRAME_SAVE
+ * @param sockfd Connected socket in framed mode
+ * @return Token of the saved game, terminates the program on error
+ */
+static uint64_t save_game(int sockfd);
+
+/**
+ * resume_game
+ * @brief Make a saved game the connection's game and replay its rounds
+ * @param sockfd Connected socket in framed mode
+ * @param token Token of the game
+ * @param solver Restarted and brought to the state after the rounds played
+ * @param strategy Strategy of the solver
+ * @param answer Set to the answer of the last round played, if any
+ * @return RESUME_* status, -1 on a connection error
+ */
+static int resume_game(int sockfd, uint64_t token, struct solver *solver,
+                       enum solver_strategy strategy, uint8_t *answer);
+
+/**
+ * reconnect
+ * @brief Connect again after the connection of a saved game dropped and
+ * resume the game, up to RESUME_ATTEMPTS times with growing pauses
+ * @param ai Address of the server
+ * @param token Token of the game
+ * @param solver Brought to the state after the rounds played
+ * @param strategy Strategy of the solver
+ * @param answer Set to the answer of the last round played, if any
+ * @return RESUME_RUNNING or RESUME_OVER, -1 if a signal was caught;
+ * terminates the program with the token if the game cannot be resumed
  */
-static void knuth_remove_sol(uint16_t guess, int *solutions, int n, int red_guess, int white_guess);
+static int reconnect(const struct addrinfo *ai, uint64_t token, struct solver *solver,
+                     enum solver_strategy strategy, uint8_t *answer);
+
+/**
+ * exchange_guess
+ * @brief Send a guess to the server and receive its answer
+ * @param sockfd Connected socket
+ * @param framed Use the framed instead of the legacy protocol
+ * @param guess The encoded guess including the parity bit
+ * @param answer Set to the server's answer
+ * @return 0 on success and -1 on error
+ */
+static int exchange_guess(int sockfd, bool framed, code_t guess, uint8_t *answer);
+
+/**
+ * exchange_frame
+ * @brief Send a request frame and receive the response frame
+ * @param sockfd Connected socket in framed mode
+ * @param buffer Request frame, overwritten with the response frame
+ * @param req_entry Size of a request entry
+ * @param resp_entry Size of a response entry
+ * @return Number of response entries, -1 on error
+ */
+static int exchange_frame(int sockfd, uint8_t *buffer, size_t req_entry, size_t resp_entry);
+
+/**
+ * play_session
+ * @brief Play games against the secrets 0 to games-1 over one connection
+ * @param sockfd Connected socket
+ * @param games Number of games
+ * @param strategy Strategy of the solvers
+ * @return EXIT_SUCCESS if all games were won, else the exit code of a failed game
+ */
+static int play_session(int sockfd, long int games, enum solver_strategy strategy);
+
+/**
+ * run_load
+ * @brief Generate load: play games over many non-blocking connections at once
+ * @param ai Address of the server
+ * @param options Parsed options with connections, games, framed and strategy
+ * @return EXIT_SUCCESS if all games were won without connection errors,
+ * else EXIT_FAILURE or the exit code of a failed game
+ */
+static int run_load(const struct addrinfo *ai, const struct opts *options);
+
+/**
+ * load_start
+ * @brief Open a connection of the load generator and start its game
+ * @param load The load generator
+ * @param conn The connection, closed
+ * @return 0 on success, -1 if the connection failed right away (counted as
+ * connection error)
+ */
+static int load_start(struct load *load, struct load_conn *conn);
+
+/**
+ * load_event
+ * @brief Handle an epoll event of a load generator connection
+ * @param load The load generator
+ * @param conn The connection
+ * @param events The epoll events
+ */
+static void load_event(struct load *load, struct load_conn *conn, uint32_t events);
+
+/**
+ * load_request
+ * @brief Queue the next request of a connection (hello or guess, with
+ * keep-alive FRAME_NEW and the first guess of a game) and send it
+ * @param load The load generator
+ * @param conn The connection
+ */
+static void load_request(struct load *load, struct load_conn *conn);
+
+/**
+ * load_flush
+ * @brief Send as much of the queued request as the socket takes
+ * @param load The load generator
+ * @param conn The connection in state LOAD_SENDING
+ * @return 0 on success (sent or would block), -1 on error
+ */
+static int load_flush(struct load *load, struct load_conn *conn);
+
+/**
+ * load_answer
+ * @brief Process a complete response of a connection
+ * @param load The load generator
+ * @param conn The connection
+ */
+static void load_answer(struct load *load, struct load_conn *conn);
+
+/**
+ * load_watch
+ * @brief Register a connection for the epoll events it waits for
+ * @param load The load generator
+ * @param conn The connection
+ * @param events EPOLLIN or EPOLLOUT
+ * @return 0 on success, -1 on error
+ */
+static int load_watch(struct load *load, struct load_conn *conn, uint32_t events);
+
+/**
+ * load_close
+ * @brief Close a connection and replace it while games are left
+ * @param load The load generator
+ * @param conn The connection
+ * @param error The game ended with a connection error
+ */
+static void load_close(struct load *load, struct load_conn *conn, bool error);
+
+/**
+ * run_verify
+ * @brief Play the secrets in process and print the report
+ * @param options Parsed options with games, threads and strategy
+ * @return EXIT_SUCCESS if every game was won without a parity error, else
+ * EXIT_FAILURE
+ */
+static int run_verify(const struct opts *options);
+
+/**
+ * run_shm
+ * @brief Play games over the shared memory region of a server on this host
+ * @param options The options, -m games are played one after the other
+ * @return EXIT_SUCCESS if every game was won, else the status of the
+ * first failed one
+ */
+static int run_shm(const struct opts *options);
+
+/**
+ * verify_thread
+ * @brief Thread function of the self-test, plays secrets until none are left
+ * @param arg The struct verify_worker
+ * @return NULL
+ */
+static void *verify_thread(void *arg);
+
+/**
+ * verify_take
+ * @brief Take the next secret of a worker's own range
+ * @param worker The worker
+ * @return Index of the secret, -1 if the range is empty
+ */
+static long verify_take(struct verify_worker *worker);
+
+/**
+ * verify_steal
+ * @brief Move the upper half of another worker's range to an empty worker
+ * @param worker The worker, its range is empty
+ * @return 1 if a range was stolen, 0 if every other range is empty
+ */
+static int verify_steal(struct verify_worker *worker);
+
+/**
+ * no_delay
+ * @brief Turn off Nagle's algorithm for a socket
+ * @param fd The socket
+ * @return 0 on success, -1 on error
+ */
+static int no_delay(int fd);
+
+/**
+ * now_ns
+ * @brief Monotonic time
+ * @return Nanoseconds since an arbitrary point
+ */
+static uint64_t now_ns(void);
+
+/**
+ * start_game
+ * @brief Start a new game of a solver, following the decision tree if one was loaded
+ * @param solver The solver
+ * @param strategy Strategy of the solver
+ */
+static void start_game(struct solver *solver, enum solver_strategy strategy);
+
+/**
+ * answer_status
+ * @brief Derive the state of a game from the server's answer
+ * @param answer The answer
+ * @return GAME_RUNNING if the game goes on, else the exit code of the game
+ */
+static int answer_status(uint8_t answer);
 
 /**
  * bail_out
@@ -160,6 +537,20 @@ int main(int argc, char *argv[]) {
   int err;
   
   parse_args(argc, argv, &options);
+  score_init();
+  /* the self-test plays games in parallel, each thread ranks its own guesses */
+  if (solver_setup(options.verify ? 1 : 0) != 0) {
+    bail_out(EXIT_FAILURE, "solver_setup");
+  }
+  if (options.tree_path != NULL && tree_open(options.tree_path, &tree) != 0) {
+    bail_out(EXIT_FAILURE, "Could not load decision tree %s", options.tree_path);
+  }
+
+  if (options.verify) {
+    int ret = run_verify(&options);
+    free_resources();
+    return ret;
+  }
 
   /* setup signal handlers */
   const int signals[] = {SIGINT, SIGTERM};
@@ -176,6 +567,12 @@ int main(int argc, char *argv[]) {
       }
   }
 
+  if (options.shm) {
+    int ret = run_shm(&options);
+    free_resources();
+    return ret;
+  }
+
   /* find address infos for speciied hostname and port */
   struct addrinfo hints, *ai_sel;
   memset(&hints, 0, sizeof hints);  
@@ -184,7 +581,7 @@ int main(int argc, char *argv[]) {
   hints.ai_socktype = SOCK_STREAM; 
   hints.ai_protocol = IPPROTO_TCP;
 
-  if ((err = getaddrinfo(options.hostname, argv[2], &hints, &ai)) != 0) {
+  if ((err = getaddrinfo(options.hostname, options.port_arg, &hints, &ai)) != 0) {
     bail_out(EXIT_FAILURE, "getaddrinfo error: %s", gai_strerror(err));
   }
 
@@ -192,151 +589,916 @@ int main(int argc, char *argv[]) {
     bail_out(EXIT_FAILURE, "Could not resolve host %s.", options.hostname);
   }
   ai_sel = ai;
+
+  if (options.connections > 0) {
+    int ret = run_load(ai_sel, &options);
+    free_resources();
+    return ret;
+  }
   
   /* create socket and set options */
   if ((sockfd = socket(ai_sel->ai_family, ai_sel->ai_socktype, ai_sel->ai_protocol)) < 0) {
     bail_out(EXIT_FAILURE, "Socket creation failed.", options.hostname);
   }
 
+  if (no_delay(sockfd) != 0) {
+    bail_out(EXIT_FAILURE, "setsockopt TCP_NODELAY");
+  }
+
   /* connect socket to server */
   if (connect(sockfd, ai_sel->ai_addr, ai_sel->ai_addrlen) < 0) {
     bail_out(EXIT_FAILURE, "Could not connect to server");
   }
+
+  if (options.games > 0) {
+    int ret = play_session(sockfd, options.games, options.strategy);
+    free_resources();
+    return ret;
+  }
+
+  if (options.framed && negotiate_framed(sockfd) != 0) {
+    bail_out(EXIT_FAILURE, "negotiate_framed");
+  }
   
-  /* init solution array, this index is the combination, 
-   * every index of the array is a combination
-   * the content of the array:
-   *    0 = possible solution
-   *    1 = solution removed
-   */
-  int solutions_max = pow(COLORS,SLOTS);
-  int solutions[solutions_max];
-  memset(solutions, 0, sizeof(int) * solutions_max);
-
-  /* starting guess */
-  uint16_t guess = (beige << 4*SHIFT_WIDTH) | (orange << 3*SHIFT_WIDTH) | (darkblue << 2*SHIFT_WIDTH) | (red << SHIFT_WIDTH) | green;
+  static struct solver solver;
+  start_game(&solver, options.strategy);
+
+  uint64_t token = options.token;
+  int resumed = RESUME_RUNNING;
+  uint8_t answer = 0;
+  if (options.resumable) {
+    /* a dropped connection is resumed, it must not end the client */
+    s.sa_handler = SIG_IGN;
+    if (sigaction(SIGPIPE, &s, NULL) < 0) {
+      bail_out(EXIT_FAILURE, "sigaction");
+    }
+    if (token == 0) {
+      token = save_game(sockfd);
+      (void) fprintf(stderr, "%s: game token %016llx\n", progname, (unsigned long long) token);
+    } else if ((resumed = resume_game(sockfd, token, &solver, options.strategy, &answer)) < 0) {
+      bail_out(EXIT_FAILURE, "resume_game");
+    } else if (resumed == RESUME_UNKNOWN) {
+      errno = 0;
+      bail_out(EXIT_FAILURE, "Server has no saved game %016llx", (unsigned long long) token);
+    }
+  }
   
   int ret = EXIT_SUCCESS;
-  int rounds = 0;
   while (true) {
-    rounds++;
-    /* removee current guess from solutions */
-    solutions[guess] = 1;
-
-    /* calculate parity bit for guess */
-    uint8_t parity_bit = 0;
-    for (int i = 0; i < SLOTS * SHIFT_WIDTH; i++) {
-      parity_bit ^= (guess >> i) & 1;
-    }
-    guess |= (parity_bit << PARITY_BIT);
-    
-    /* transform int-guess to 1 byte buffer */
-    uint8_t buffer[BUFFER_BYTES];
-    memset(&buffer, 0, sizeof buffer);  
+    /* a resumed game that is over only reports the last answer */
+    if (resumed == RESUME_RUNNING) {
+      code_t guess = solver_next_guess(&solver);
 
-    for (int i = 0; i < 2; i++) {
-      buffer[i] = (guess >> i*8);
-    }
- 
-    /* send guess to server */
-    if (write_to_server(sockfd, buffer, WRITE_BYTES) != 0) {
-      if (quit) break; /* caught signal */
-      bail_out(EXIT_FAILURE, "write_to_server");
-    } 
-    
-    /* receive response from server */
-    if (read_from_server(sockfd, buffer, READ_BYTES) == NULL) {
-      if (quit) break; /* caught signal */
-      bail_out(EXIT_FAILURE, "read_from_server");
+      /* send guess to server and receive its response */
+      if (exchange_guess(sockfd, options.framed, guess, &answer) != 0) {
+        if (quit) break; /* caught signal */
+        if (!options.resumable) {
+          bail_out(EXIT_FAILURE, "exchange_guess");
+        }
+        /* the guess may or may not have been played, the resumed game tells */
+        resumed = reconnect(ai_sel, token, &solver, options.strategy, &answer);
+        if (resumed < 0) break; /* caught signal */
+        if (resumed == RESUME_RUNNING) continue;
+      }
     }
     
-    /* extract informations from server response and check status */
-    uint8_t red = (buffer[0] & 7);
-    uint8_t white = (buffer[0] >> 3) & 7;
-    uint8_t parity_check = (buffer[0] >> PARITY_ERR_BIT) & 1;
-    uint8_t game_lost_check = (buffer[0] >> GAME_LOST_ERR_BIT) & 1; 
-
-    DEBUG("Status - red: %i, white: %i, parity check: %i, end: %i\n", red, white, parity_check, status);
-    if (red == SLOTS) {
-      (void) fprintf(stdout, "Runden %d\n", rounds);
+    /* check status of the server response */
+    ret = answer_status(answer);
+    DEBUG("Status - red: %i, white: %i, status: %i\n", answer & 7, (answer >> 3) & 7, ret);
+    if (ret == EXIT_SUCCESS) {
+      (void) fprintf(stdout, "Runden %d\n", solver.rounds);
       break;
     }
-    if (game_lost_check == 1) {
+    if (ret == EXIT_GAME_LOST) {
       (void) fprintf(stdout, "Game lost\n");
-      ret = EXIT_GAME_LOST;
       break;
     }
-    if (parity_check == 1) {
+    if (ret == EXIT_PARITY_ERROR || ret == EXIT_MULTIPLE_ERRORS) {
       (void) fprintf(stdout, "Parity error\n");
-      if (ret == EXIT_GAME_LOST) {
-        ret = EXIT_MULTIPLE_ERRORS;
-      } else {
-        ret = EXIT_PARITY_ERROR;
-      }
       break;
     }
     
-    // knuth alg - remove non possible solutions
-    knuth_remove_sol(guess, solutions, solutions_max, red, white);
-        
-    // pick next guess
-    int active = 0;
-    for (int i = solutions_max-1; i >= 0; --i) {
-      if (solutions[i] == 0) {
-        active++;
-        guess = i;
-        break;
-      }
-    }
+    solver_update(&solver, answer);
+  }
+  if (ret == GAME_RUNNING) {
+    ret = EXIT_SUCCESS; /* caught signal */
   }
   
   free_resources();
   return ret;
 }
 
-static void knuth_remove_sol(uint16_t guess, int *solutions, int n, int red_guess, int white_guess) {
-  int red, white;
-  int colors_left[COLORS];
-  int k = 0;
+static int play_session(int fd, long int games, enum solver_strategy strategy) {
+  static struct solver solvers[SESSION_BATCH];
+  static uint8_t buffer[FRAME_HEADER_BYTES + SESSION_BATCH * SESSION_REQ_BYTES];
+  uint16_t active[SESSION_BATCH];
+  unsigned long histogram[MAX_TRIES + 1];
+  unsigned long won = 0, total_rounds = 0;
+  int max_rounds = 0;
+  int ret = EXIT_SUCCESS;
 
-  for (int sol = 0; sol < n; sol++) {
-    red = white = 0;
-    (void) memset(&colors_left[0], 0, sizeof(colors_left));    
-    
-    if (solutions[sol] == 0) {
-      // calc red colors
-      for (int j = 0; j < SLOTS; j++) {
-        int guess_color = (guess >> (j * SHIFT_WIDTH)) & 7;
-        int sol_color = (sol >> (j * SHIFT_WIDTH)) & 7;
-        if (guess_color == sol_color) {
-          red++;
-        } else {
-          colors_left[guess_color]++;
-        }
+  memset(histogram, 0, sizeof histogram);
+  if (negotiate_framed(fd) != 0) {
+    bail_out(EXIT_FAILURE, "negotiate_framed");
+  }
+
+  for (long int base = 0; base < games && !quit; base += SESSION_BATCH) {
+    int n = games - base < SESSION_BATCH ? games - base : SESSION_BATCH;
+    int count;
+
+    /* open the games of this batch, game id i plays against valid code base + i */
+    frame_header(buffer, FRAME_OPEN, n);
+    for (int i = 0; i < n; i++) {
+      uint8_t *entry = buffer + FRAME_HEADER_BYTES + i * SESSION_REQ_BYTES;
+      put16(entry, i);
+      put_code(entry + 2, code_from_index(base + i));
+      start_game(&solvers[i], strategy);
+      active[i] = i;
+    }
+    count = exchange_frame(fd, buffer, SESSION_REQ_BYTES, SESSION_RESP_BYTES);
+    if (count != n || buffer[0] != FRAME_OPEN) {
+      if (quit) break; /* caught signal */
+      bail_out(EXIT_FAILURE, "Could not open games");
+    }
+    for (int i = 0; i < n; i++) {
+      if (buffer[FRAME_HEADER_BYTES + i * SESSION_RESP_BYTES + 2] != OPEN_OK) {
+        errno = 0;
+        bail_out(EXIT_FAILURE, "Server refused game %d", i);
+      }
+    }
+
+    /* one guess for every running game per round trip */
+    while (n > 0 && !quit) {
+      int running = 0;
+
+      frame_header(buffer, FRAME_PLAY, n);
+      for (int i = 0; i < n; i++) {
+        uint8_t *entry = buffer + FRAME_HEADER_BYTES + i * SESSION_REQ_BYTES;
+        put16(entry, active[i]);
+        put_code(entry + 2, solver_next_guess(&solvers[active[i]]));
+      }
+      count = exchange_frame(fd, buffer, SESSION_REQ_BYTES, SESSION_RESP_BYTES);
+      if (count != n || buffer[0] != FRAME_PLAY) {
+        if (quit) break; /* caught signal */
+        bail_out(EXIT_FAILURE, "exchange_frame");
       }
 
-      // calc white colors
-      for (int j = 0; j < SLOTS; j++) {
-        int guess_color = (guess >> (j * SHIFT_WIDTH)) & 7;
-        int sol_color = (sol >> (j * SHIFT_WIDTH)) & 7;
-        if (guess_color != sol_color) {
-           if (colors_left[sol_color] > 0) {
-            white++;
-            colors_left[sol_color]--;
+      for (int i = 0; i < count; i++) {
+        uint8_t *entry = buffer + FRAME_HEADER_BYTES + i * SESSION_RESP_BYTES;
+        uint16_t id = get16(entry);
+        struct solver *solver;
+        int status;
+
+        if (id >= SESSION_BATCH || entry[2] == ANSWER_NO_GAME) {
+          errno = 0;
+          bail_out(EXIT_FAILURE, "Server lost game %d", id);
+        }
+        solver = &solvers[id];
+        status = answer_status(entry[2]);
+        if (status == GAME_RUNNING) {
+          solver_update(solver, entry[2]);
+          active[running++] = id;
+          continue;
+        }
+        if (status == EXIT_SUCCESS) {
+          won++;
+          total_rounds += solver->rounds;
+          histogram[solver->rounds]++;
+          if (solver->rounds > max_rounds) {
+            max_rounds = solver->rounds;
           }
+        } else {
+          (void) fprintf(stderr, "Secret %ld: %s\n", base + id,
+                         status == EXIT_GAME_LOST ? "Game lost" : "Parity error");
+          ret = status;
         }
       }
-      
-      // delete solution if it has a different score than the guess
-      if (red != red_guess || white != white_guess) {
-        solutions[sol] = 1;
-        k++;      
+      n = running;
+    }
+  }
+
+  for (int i = 1; i <= MAX_TRIES; i++) {
+    if (histogram[i] > 0) {
+      (void) fprintf(stdout, "Runden %d: %lu\n", i, histogram[i]);
+    }
+  }
+  (void) fprintf(stdout, "Games won: %lu/%ld, max Runden %d, avg Runden %.3f\n",
+                 won, games, max_rounds, won > 0 ? (double) total_rounds / won : 0.0);
+  return ret;
+}
+
+static int run_load(const struct addrinfo *ai, const struct opts *options) {
+  static struct load load;
+  struct epoll_event events[LOAD_EVENTS];
+  struct load_conn *conns;
+  struct rlimit limit;
+  uint64_t start;
+  double seconds;
+  unsigned long games;
+
+  /* every connection needs a descriptor */
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+      limit.rlim_cur < (rlim_t) options->connections + LOAD_SPARE_FDS) {
+    limit.rlim_cur = (rlim_t) options->connections + LOAD_SPARE_FDS;
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_cur > limit.rlim_max) {
+      limit.rlim_cur = limit.rlim_max;
+    }
+    (void) setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  if ((conns = calloc(options->connections, sizeof *conns)) == NULL) {
+    bail_out(EXIT_FAILURE, "calloc");
+  }
+  if ((load.epfd = epoll_create1(0)) < 0) {
+    bail_out(EXIT_FAILURE, "epoll_create1");
+  }
+  load.ai = ai;
+  load.framed = options->framed;
+  load.keepalive = options->keepalive;
+  load.strategy = options->strategy;
+  load.games = options->games > 0 ? options->games : options->connections;
+
+  start = now_ns();
+  for (long int i = 0; i < options->connections; i++) {
+    conns[i].fd = -1;
+    while (load.started < load.games && load_start(&load, &conns[i]) != 0) {
+      /* counted as connection error, start the next game */
+    }
+  }
+  while (load.active > 0 && !quit) {
+    int n = epoll_wait(load.epfd, events, LOAD_EVENTS, -1);
+    if (n < 0) {
+      if (errno == EINTR) continue; /* caught signal */
+      bail_out(EXIT_FAILURE, "epoll_wait");
+    }
+    for (int i = 0; i < n; i++) {
+      load_event(&load, events[i].data.ptr, events[i].events);
+    }
+  }
+  seconds = (now_ns() - start) / 1e9;
+
+  for (long int i = 0; i < options->connections; i++) {
+    if (conns[i].fd >= 0) {
+      (void) close(conns[i].fd);
+    }
+  }
+  (void) close(load.epfd);
+  free(conns);
+
+  games = load.won + load.lost + load.parity_errors;
+  (void) fprintf(stdout, "Games: %lu won, %lu lost, %lu parity errors, %lu connection errors\n",
+                 load.won, load.lost, load.parity_errors, load.errors);
+  (void) fprintf(stdout, "%lu games in %.3f s, %.1f games/s, %ld connections\n",
+                 games, seconds, seconds > 0 ? games / seconds : 0.0, options->connections);
+  (void) fprintf(stdout, "Round latency: p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us (%lu rounds)\n",
+                 histogram_percentile(&load.rounds, 50) / 1e3,
+                 histogram_percentile(&load.rounds, 99) / 1e3,
+                 histogram_percentile(&load.rounds, 99.9) / 1e3,
+                 load.rounds.max / 1e3, (unsigned long) load.rounds.total);
+
+  if (load.errors > 0) {
+    return EXIT_FAILURE;
+  }
+  if (load.parity_errors > 0) {
+    return EXIT_PARITY_ERROR;
+  }
+  if (load.lost > 0) {
+    return EXIT_GAME_LOST;
+  }
+  return EXIT_SUCCESS;
+}
+
+static int load_start(struct load *load, struct load_conn *conn) {
+  load->started++;
+  conn->events = 0;
+  conn->hello = false;
+  conn->state = LOAD_CONNECTING;
+  if ((conn->fd = socket(load->ai->ai_family, load->ai->ai_socktype, load->ai->ai_protocol)) < 0) {
+    load->errors++;
+    return -1;
+  }
+  /* the first request is sent once the socket is writable, even if connect completes at once */
+  if (fcntl(conn->fd, F_SETFL, O_NONBLOCK) < 0 || no_delay(conn->fd) != 0 ||
+      (connect(conn->fd, load->ai->ai_addr, load->ai->ai_addrlen) < 0 && errno != EINPROGRESS) ||
+      load_watch(load, conn, EPOLLOUT) != 0) {
+    DEBUG("Connection error: %s\n", strerror(errno));
+    (void) close(conn->fd);
+    conn->fd = -1;
+    load->errors++;
+    return -1;
+  }
+  start_game(&conn->solver, load->strategy);
+  load->active++;
+  return 0;
+}
+
+static void load_event(struct load *load, struct load_conn *conn, uint32_t events) {
+  switch (conn->state) {
+  case LOAD_CONNECTING: {
+    int error = 0;
+    socklen_t len = sizeof error;
+
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+      load_close(load, conn, true);
+      return;
+    }
+    load_request(load, conn);
+    break;
+  }
+  case LOAD_SENDING:
+    if (load_flush(load, conn) != 0) {
+      load_close(load, conn, true);
+    }
+    break;
+  case LOAD_RECEIVING:
+    while (conn->inoff < conn->inlen) {
+      ssize_t r = recv(conn->fd, conn->in + conn->inoff, conn->inlen - conn->inoff, 0);
+      if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+      }
+      if (r <= 0) {
+        /* closed by the server before the game was over */
+        load_close(load, conn, true);
+        return;
       }
-    }   
-    
+      conn->inoff += r;
+    }
+    load_answer(load, conn);
+    break;
+  }
+}
+
+static void load_request(struct load *load, struct load_conn *conn) {
+  uint8_t *payload = load->framed ? conn->out + FRAME_HEADER_BYTES : conn->out;
+
+  if (load->framed && conn->state == LOAD_CONNECTING) {
+    /* the hello goes first and is answered with a single byte */
+    conn->hello = true;
+    put_code(conn->out, PROTO_HELLO);
+    conn->outlen = GUESS_BYTES;
+    conn->inlen = ANSWER_BYTES;
+  } else if (load->keepalive && conn->solver.rounds == 0) {
+    /* a new game against the server's secret, answered before the guess */
+    conn->hello = false;
+    conn->renew = true;
+    frame_header(conn->out, FRAME_NEW, 1);
+    put_code(conn->out + FRAME_HEADER_BYTES, SECRET_SERVER);
+    frame_header(conn->out + BUFFER_BYTES, FRAME_GUESSES, 1);
+    put_code(conn->out + BUFFER_BYTES + FRAME_HEADER_BYTES, solver_next_guess(&conn->solver));
+    conn->outlen = 2 * BUFFER_BYTES;
+    conn->inlen = 2 * (FRAME_HEADER_BYTES + READ_BYTES);
+  } else {
+    conn->hello = false;
+    conn->renew = false;
+    put_code(payload, solver_next_guess(&conn->solver));
+    if (load->framed) {
+      frame_header(conn->out, FRAME_GUESSES, 1);
+    }
+    conn->outlen = (payload - conn->out) + WRITE_BYTES;
+    conn->inlen = (payload - conn->out) + READ_BYTES;
+  }
+  conn->outoff = 0;
+  conn->inoff = 0;
+  conn->state = LOAD_SENDING;
+  conn->sent = now_ns();
+  if (load_flush(load, conn) != 0) {
+    load_close(load, conn, true);
   }
 }
 
+static int load_flush(struct load *load, struct load_conn *conn) {
+  while (conn->outoff < conn->outlen) {
+    ssize_t s = send(conn->fd, conn->out + conn->outoff, conn->outlen - conn->outoff, MSG_NOSIGNAL);
+    if (s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return load_watch(load, conn, EPOLLOUT);
+    }
+    if (s <= 0) {
+      return -1;
+    }
+    conn->outoff += s;
+  }
+  conn->state = LOAD_RECEIVING;
+  return load_watch(load, conn, EPOLLIN);
+}
+
+static void load_answer(struct load *load, struct load_conn *conn) {
+  uint8_t answer = conn->in[conn->inlen - 1];
+  int status;
+
+  if (conn->hello) {
+    /* a legacy server takes the hello for a guess with a parity error */
+    if ((answer >> PARITY_ERR_BIT) & 1) {
+      load_close(load, conn, true);
+      return;
+    }
+    load_request(load, conn);
+    return;
+  }
+  histogram_record(&load->rounds, now_ns() - conn->sent);
+  if (conn->renew && (conn->in[0] != FRAME_NEW || frame_count(conn->in) != 1 ||
+                      conn->in[FRAME_HEADER_BYTES] != OPEN_OK)) {
+    load_close(load, conn, true);
+    return;
+  }
+  if (load->framed) {
+    const uint8_t *frame = conn->in + conn->inlen - (FRAME_HEADER_BYTES + READ_BYTES);
+    if (frame[0] != FRAME_GUESSES || frame_count(frame) != 1) {
+      load_close(load, conn, true);
+      return;
+    }
+  }
+
+  status = answer_status(answer);
+  if (status == GAME_RUNNING) {
+    solver_update(&conn->solver, answer);
+    load_request(load, conn);
+    return;
+  }
+  if (status == EXIT_SUCCESS) {
+    load->won++;
+  } else if (status == EXIT_GAME_LOST) {
+    load->lost++;
+  } else {
+    load->parity_errors++;
+  }
+  if (load->keepalive && load->started < load->games && !quit) {
+    /* the next game goes over the same connection */
+    load->started++;
+    start_game(&conn->solver, load->strategy);
+    load_request(load, conn);
+    return;
+  }
+  load_close(load, conn, false);
+}
+
+static int load_watch(struct load *load, struct load_conn *conn, uint32_t events) {
+  struct epoll_event ev;
+  int op = conn->events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+
+  if (conn->events == events) {
+    return 0;
+  }
+  ev.events = events;
+  ev.data.ptr = conn;
+  if (epoll_ctl(load->epfd, op, conn->fd, &ev) < 0) {
+    return -1;
+  }
+  conn->events = events;
+  return 0;
+}
+
+static void load_close(struct load *load, struct load_conn *conn, bool error) {
+  if (error) {
+    DEBUG("Connection error: %s\n", strerror(errno));
+    load->errors++;
+  }
+  /* closing removes the descriptor from the epoll set */
+  (void) close(conn->fd);
+  conn->fd = -1;
+  load->active--;
+  while (load->started < load->games && !quit && load_start(load, conn) != 0) {
+    /* counted as connection error, start the next game */
+  }
+}
+
+static int run_verify(const struct opts *options) {
+  struct verify verify;
+  unsigned long histogram[MAX_TRIES + 1];
+  unsigned long won = 0, lost = 0, parity_errors = 0, steals = 0, total_rounds = 0;
+  long int count = options->games > 0 ? options->games : VALID_CODES;
+  int max_rounds = 0;
+  uint64_t start;
+  double seconds;
+
+  verify.strategy = options->strategy;
+  verify.threads = options->threads > 0 ? options->threads : sysconf(_SC_NPROCESSORS_ONLN);
+  if (verify.threads < 1) {
+    verify.threads = 1;
+  }
+  if (verify.threads > VERIFY_MAX_THREADS) {
+    verify.threads = VERIFY_MAX_THREADS;
+  }
+  if (posix_memalign((void **) &verify.workers, 64, verify.threads * sizeof *verify.workers) != 0) {
+    bail_out(EXIT_FAILURE, "posix_memalign");
+  }
+  memset(verify.workers, 0, verify.threads * sizeof *verify.workers);
+
+  start = now_ns();
+  for (int i = 0; i < verify.threads; i++) {
+    struct verify_worker *worker = &verify.workers[i];
+
+    /* an even share of the secrets to start with */
+    worker->range = (uint64_t) (count * (i + 1) / verify.threads) << 32 | (count * i / verify.threads);
+    worker->verify = &verify;
+    worker->index = i;
+  }
+  for (int i = 0; i < verify.threads; i++) {
+    if ((errno = pthread_create(&verify.workers[i].thread, NULL, verify_thread,
+                                &verify.workers[i])) != 0) {
+      bail_out(EXIT_FAILURE, "pthread_create");
+    }
+  }
+  for (int i = 0; i < verify.threads; i++) {
+    (void) pthread_join(verify.workers[i].thread, NULL);
+  }
+  seconds = (now_ns() - start) / 1e9;
+
+  memset(histogram, 0, sizeof histogram);
+  for (int i = 0; i < verify.threads; i++) {
+    struct verify_worker *worker = &verify.workers[i];
+
+    for (int r = 1; r <= MAX_TRIES; r++) {
+      histogram[r] += worker->histogram[r];
+      total_rounds += r * worker->histogram[r];
+      if (worker->histogram[r] > 0 && r > max_rounds) {
+        max_rounds = r;
+      }
+    }
+    won += worker->won;
+    lost += worker->lost;
+    parity_errors += worker->parity_errors;
+    steals += worker->steals;
+  }
+  free(verify.workers);
+
+  (void) printf("{\"slots\": %d, \"colors\": %d, \"strategy\": \"%s\", \"tree\": %s%s%s, "
+                "\"secrets\": %ld, \"threads\": %d, \"won\": %lu, \"lost\": %lu, "
+                "\"parity_errors\": %lu, \"max_rounds\": %d, \"avg_rounds\": %.4f, \"rounds\": [",
+                SLOTS, COLORS, solver_strategy_name(options->strategy),
+                options->tree_path != NULL ? "\"" : "",
+                options->tree_path != NULL ? options->tree_path : "null",
+                options->tree_path != NULL ? "\"" : "",
+                count, verify.threads, won, lost, parity_errors, max_rounds,
+                won > 0 ? (double) total_rounds / won : 0.0);
+  for (int r = 1; r <= max_rounds; r++) {
+    (void) printf("%s%lu", r > 1 ? ", " : "", histogram[r]);
+  }
+  (void) printf("], \"steals\": %lu, \"seconds\": %.6f, \"ok\": %s}\n", steals, seconds,
+                won == (unsigned long) count && parity_errors == 0 ? "true" : "false");
+
+  return won == (unsigned long) count && parity_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int run_shm(const struct opts *options) {
+  static struct solver solver;
+  static struct histogram rounds;
+  unsigned long won = 0, lost = 0, parity_errors = 0;
+  long int games = options->games > 0 ? options->games : 1;
+  int ret = EXIT_SUCCESS;
+  uint64_t start;
+  double seconds;
+
+  if ((shm = shm_attach(options->port)) == NULL) {
+    bail_out(EXIT_FAILURE, "Could not attach to the shared memory of port %ld", options->port);
+  }
+
+  start = now_ns();
+  for (long int i = 0; i < games && !quit; i++) {
+    int status = GAME_RUNNING;
+
+    errno = 0;
+    if ((shm_channel = shm_claim(shm, options->shm_poll)) == NULL) {
+      bail_out(EXIT_FAILURE, "All shared memory channels are in use");
+    }
+    start_game(&solver, options->strategy);
+    while (status == GAME_RUNNING) {
+      code_t guess = solver_next_guess(&solver);
+      uint64_t sent = now_ns();
+      uint8_t answer;
+
+      if (shm_send(shm, shm_channel, guess) != 0 ||
+          shm_receive(shm, shm_channel, &answer) != 0) {
+        bail_out(EXIT_FAILURE, "Server shut down");
+      }
+      histogram_record(&rounds, now_ns() - sent);
+      if (answer == ANSWER_NO_GAME) {
+        bail_out(EXIT_FAILURE, "Server has no game for the channel");
+      }
+      status = answer_status(answer);
+      if (status == GAME_RUNNING) {
+        solver_update(&solver, answer);
+      }
+    }
+    shm_release(shm_channel);
+    shm_channel = NULL;
+
+    switch (status) {
+    case EXIT_SUCCESS:
+      won++;
+      break;
+    case EXIT_GAME_LOST:
+      lost++;
+      break;
+    default:
+      parity_errors++;
+      break;
+    }
+    if (ret == EXIT_SUCCESS) {
+      ret = status;
+    }
+    if (options->games == 0) {
+      /* a single game reports like one over a socket */
+      if (status == EXIT_SUCCESS) {
+        (void) fprintf(stdout, "Runden %d\n", solver.rounds);
+      } else if (status == EXIT_GAME_LOST) {
+        (void) fprintf(stdout, "Game lost\n");
+      } else {
+        (void) fprintf(stdout, "Parity error\n");
+      }
+      return ret;
+    }
+  }
+  seconds = (now_ns() - start) / 1e9;
+
+  (void) fprintf(stdout, "Games: %lu won, %lu lost, %lu parity errors\n",
+                 won, lost, parity_errors);
+  (void) fprintf(stdout, "%lu games in %.3f s, %.1f games/s, %s\n", won + lost + parity_errors,
+                 seconds, seconds > 0 ? (won + lost + parity_errors) / seconds : 0.0,
+                 options->shm_poll ? "busy-polling" : "futex wakeups");
+  (void) fprintf(stdout, "Round latency: p50 %.2f us, p99 %.2f us, p99.9 %.2f us, max %.1f us (%lu rounds)\n",
+                 histogram_percentile(&rounds, 50) / 1e3,
+                 histogram_percentile(&rounds, 99) / 1e3,
+                 histogram_percentile(&rounds, 99.9) / 1e3,
+                 rounds.max / 1e3, (unsigned long) rounds.total);
+  return ret;
+}
+
+static void *verify_thread(void *arg) {
+  struct verify_worker *worker = arg;
+  struct solver *solver;
+  long int next;
+
+  if ((solver = malloc(sizeof *solver)) == NULL) {
+    bail_out(EXIT_FAILURE, "malloc");
+  }
+  while (!quit && ((next = verify_take(worker)) >= 0 || verify_steal(worker))) {
+    int status = GAME_RUNNING;
+    code_t secret;
+
+    if (next < 0) {
+      continue; /* stolen a range, take from it */
+    }
+    secret = code_from_index(next);
+    start_game(solver, worker->verify->strategy);
+    while (status == GAME_RUNNING) {
+      /* the guess as main() sends it, scored by the server's rules */
+      code_t guess = solver_next_guess(solver);
+      uint8_t answer;
+
+      (void) play_round(solver->rounds, guess, &answer, secret);
+      status = answer_status(answer);
+      if (status == GAME_RUNNING) {
+        solver_update(solver, answer);
+      }
+    }
+    switch (status) {
+    case EXIT_SUCCESS:
+      worker->won++;
+      worker->histogram[solver->rounds]++;
+      break;
+    case EXIT_GAME_LOST:
+      worker->lost++;
+      break;
+    default:
+      worker->parity_errors++;
+      break;
+    }
+  }
+  free(solver);
+  return NULL;
+}
+
+static long verify_take(struct verify_worker *worker) {
+  uint64_t range = __atomic_load_n(&worker->range, __ATOMIC_ACQUIRE);
+
+  while ((uint32_t) range < (uint32_t) (range >> 32)) {
+    if (__atomic_compare_exchange_n(&worker->range, &range, range + 1, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      return (uint32_t) range;
+    }
+  }
+  return -1;
+}
+
+static int verify_steal(struct verify_worker *worker) {
+  struct verify *verify = worker->verify;
+
+  for (int i = 1; i < verify->threads; i++) {
+    struct verify_worker *victim = &verify->workers[(worker->index + i) % verify->threads];
+    uint64_t range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+
+    while ((uint32_t) range < (uint32_t) (range >> 32)) {
+      uint32_t next = range, end = range >> 32;
+      /* the victim keeps the lower half, a single secret is taken whole */
+      uint32_t mid = next + (end - next) / 2;
+
+      if (__atomic_compare_exchange_n(&victim->range, &range, (uint64_t) mid << 32 | next,
+                                      false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        /* no thief touches an empty range, so a plain store will do */
+        __atomic_store_n(&worker->range, (uint64_t) end << 32 | mid, __ATOMIC_RELEASE);
+        worker->steals++;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static int no_delay(int fd) {
+  int optval = 1;
+
+  return setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof optval) < 0 ? -1 : 0;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void start_game(struct solver *solver, enum solver_strategy strategy) {
+  solver_init(solver, strategy);
+  if (tree.header != NULL) {
+    solver_follow(solver, &tree);
+  }
+}
+
+static int answer_status(uint8_t answer) {
+  /* extract informations from server response */
+  uint8_t red = (answer & 7);
+  uint8_t parity_check = (answer >> PARITY_ERR_BIT) & 1;
+  uint8_t game_lost_check = (answer >> GAME_LOST_ERR_BIT) & 1; 
+
+  if (red == SLOTS) {
+    return EXIT_SUCCESS;
+  }
+  if (game_lost_check == 1 && parity_check == 1) {
+    return EXIT_MULTIPLE_ERRORS;
+  }
+  if (game_lost_check == 1) {
+    return EXIT_GAME_LOST;
+  }
+  if (parity_check == 1) {
+    return EXIT_PARITY_ERROR;
+  }
+  return GAME_RUNNING;
+}
+
+static int negotiate_framed(int fd) {
+  uint8_t buffer[GUESS_BYTES];
+
+  put_code(buffer, PROTO_HELLO);
+  if (write_to_server(fd, buffer, GUESS_BYTES) != 0 ||
+      read_from_server(fd, buffer, ANSWER_BYTES) == NULL) {
+    return -1;
+  }
+  /* a legacy server takes the hello for a guess with a parity error */
+  if ((buffer[0] >> PARITY_ERR_BIT) & 1) {
+    errno = 0;
+    bail_out(EXIT_FAILURE, "Server does not support the framed protocol");
+  }
+  DEBUG("Server speaks framed protocol version %d\n", buffer[0]);
+  return 0;
+}
+
+static uint64_t save_game(int fd) {
+  uint8_t buffer[FRAME_HEADER_BYTES + SAVE_RESP_BYTES];
+
+  frame_header(buffer, FRAME_SAVE, 1);
+  put_code(buffer + FRAME_HEADER_BYTES, SECRET_SERVER);
+  if (exchange_frame(fd, buffer, GUESS_BYTES, SAVE_RESP_BYTES) != 1 ||
+      buffer[0] != FRAME_SAVE) {
+    bail_out(EXIT_FAILURE, "save_game");
+  }
+  if (buffer[FRAME_HEADER_BYTES] != OPEN_OK) {
+    errno = 0;
+    bail_out(EXIT_FAILURE, "Server keeps no game table");
+  }
+  return get64(buffer + FRAME_HEADER_BYTES + ANSWER_BYTES);
+}
+
+static int resume_game(int fd, uint64_t token, struct solver *solver,
+                       enum solver_strategy strategy, uint8_t *answer) {
+  uint8_t buffer[FRAME_HEADER_BYTES + (MAX_TRIES + 1) * RESUME_ENTRY_BYTES];
+  const uint8_t *entry = buffer + FRAME_HEADER_BYTES;
+  uint16_t count;
+  int status;
+
+  frame_header(buffer, FRAME_RESUME, 1);
+  put64(buffer + FRAME_HEADER_BYTES, token);
+  if (write_to_server(fd, buffer, FRAME_HEADER_BYTES + RESUME_TOKEN_BYTES) != 0 ||
+      read_from_server(fd, buffer, FRAME_HEADER_BYTES) == NULL) {
+    return -1;
+  }
+  /* the status entry, then one entry per round played */
+  count = frame_count(buffer);
+  if (buffer[0] != FRAME_RESUME || count < 1 || count > MAX_TRIES + 1 ||
+      read_from_server(fd, buffer + FRAME_HEADER_BYTES, count * RESUME_ENTRY_BYTES) == NULL) {
+    return -1;
+  }
+  status = entry[GUESS_BYTES];
+  if (status == RESUME_UNKNOWN) {
+    return status;
+  }
+  start_game(solver, strategy);
+  for (int i = 1; i < count; i++) {
+    entry += RESUME_ENTRY_BYTES;
+    *answer = entry[GUESS_BYTES];
+    solver_replay(solver, get_code(entry), *answer);
+  }
+  DEBUG("Resumed game %016llx after round %d\n", (unsigned long long) token, solver->rounds);
+  return status;
+}
+
+static int reconnect(const struct addrinfo *ai, uint64_t token, struct solver *solver,
+                     enum solver_strategy strategy, uint8_t *answer) {
+  long pause = RESUME_PAUSE_MS;
+
+  for (int attempt = 1; attempt <= RESUME_ATTEMPTS && !quit; attempt++) {
+    struct timespec ts;
+    int status;
+
+    if (sockfd >= 0) {
+      (void) close(sockfd);
+      sockfd = -1;
+    }
+    DEBUG("Connection lost, attempt %d to resume in %ld ms\n", attempt, pause);
+    ts.tv_sec = pause / 1000;
+    ts.tv_nsec = (pause % 1000) * 1000000L;
+    (void) nanosleep(&ts, NULL);
+    pause *= 2;
+
+    if ((sockfd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0 ||
+        no_delay(sockfd) != 0 || connect(sockfd, ai->ai_addr, ai->ai_addrlen) < 0 ||
+        negotiate_framed(sockfd) != 0) {
+      continue;
+    }
+    if ((status = resume_game(sockfd, token, solver, strategy, answer)) == RESUME_UNKNOWN) {
+      errno = 0;
+      bail_out(EXIT_FAILURE, "Server has no saved game %016llx", (unsigned long long) token);
+    }
+    if (status >= 0) {
+      return status;
+    }
+  }
+  if (quit) {
+    return -1;
+  }
+  errno = 0;
+  bail_out(EXIT_FAILURE, "Connection lost, resume the game with -r %016llx",
+           (unsigned long long) token);
+  return -1;
+}
+
+static int exchange_guess(int fd, bool framed, code_t guess, uint8_t *answer) {
+  uint8_t buffer[BUFFER_BYTES];
+  uint8_t *payload = framed ? buffer + FRAME_HEADER_BYTES : buffer;
+
+  /* transform int-guess to GUESS_BYTES little endian */
+  put_code(payload, guess);
+
+  /* one guess per frame, the solver needs every answer before its next guess */
+  if (framed) {
+    frame_header(buffer, FRAME_GUESSES, 1);
+    if (exchange_frame(fd, buffer, WRITE_BYTES, READ_BYTES) != 1 ||
+        buffer[0] != FRAME_GUESSES) {
+      return -1;
+    }
+  } else {
+    if (write_to_server(fd, buffer, WRITE_BYTES) != 0) {
+      return -1;
+    }
+    if (read_from_server(fd, buffer, READ_BYTES) == NULL) {
+      return -1;
+    }
+  }
+  *answer = payload[0];
+  return 0;
+}
+
+static int exchange_frame(int fd, uint8_t *buffer, size_t req_entry, size_t resp_entry) {
+  uint16_t sent = frame_count(buffer);
+  uint16_t count;
+
+  if (write_to_server(fd, buffer, FRAME_HEADER_BYTES + sent * req_entry) != 0) {
+    return -1;
+  }
+  if (read_from_server(fd, buffer, FRAME_HEADER_BYTES) == NULL) {
+    return -1;
+  }
+  /* never more answers than requests, so the buffer is large enough */
+  count = frame_count(buffer);
+  if (count > sent) {
+    return -1;
+  }
+  if (count > 0 &&
+      read_from_server(fd, buffer + FRAME_HEADER_BYTES, count * resp_entry) == NULL) {
+    return -1;
+  }
+  return count;
+}
+
 static int write_to_server(int fd, uint8_t *buffer, size_t n) {
   size_t bytes_sent = 0;
   do {
@@ -373,17 +1535,118 @@ static uint8_t *read_from_server(int fd, uint8_t *buffer, size_t n) {
 static void parse_args(int argc, char **argv, struct opts *options) {
   char *port_arg;
   char *endptr;
+  int c;
  
   if (argc > 0) {
     progname = argv[0];
   }
   
-  if (argc != 3) {
-    bail_out(EXIT_FAILURE, "Usage %s <server-hostname> <server-port>\n", progname); 
+  options->framed = false;
+  options->keepalive = false;
+  options->games = 0;
+  options->strategy = SOLVER_DEFAULT;
+  options->tree_path = NULL;
+  options->connections = 0;
+  options->verify = false;
+  options->threads = 0;
+  options->shm = false;
+  options->shm_poll = false;
+  options->resumable = false;
+  options->token = 0;
+  while ((c = getopt(argc, argv, "fgj:kl:m:r:s:t:v")) != -1) {
+    switch (c) {
+    case 'f':
+      options->framed = true;
+      break;
+    case 'g':
+      /* FRAME_SAVE is part of the framed protocol */
+      options->resumable = true;
+      options->framed = true;
+      break;
+    case 'r':
+      errno = 0;
+      options->token = strtoull(optarg, &endptr, 16);
+      if (endptr == optarg || *endptr != '\0' || errno != 0 || options->token == 0) {
+        errno = 0;
+        bail_out(EXIT_FAILURE, "<token> has to be the hexadecimal token of a saved game");
+      }
+      options->resumable = true;
+      options->framed = true;
+      break;
+    case 'j':
+      options->threads = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || options->threads < 1 ||
+          options->threads > VERIFY_MAX_THREADS) {
+        bail_out(EXIT_FAILURE, "<threads> has to be in range 1-%d", VERIFY_MAX_THREADS);
+      }
+      break;
+    case 'v':
+      options->verify = true;
+      break;
+    case 'k':
+      /* FRAME_NEW is part of the framed protocol */
+      options->keepalive = true;
+      options->framed = true;
+      break;
+    case 'l':
+      options->connections = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || options->connections < 1 ||
+          options->connections > LOAD_MAX_CONNECTIONS) {
+        bail_out(EXIT_FAILURE, "<connections> has to be in range 1-%d", LOAD_MAX_CONNECTIONS);
+      }
+      break;
+    case 'm':
+      options->games = strtol(optarg, &endptr, 10);
+      if (endptr == optarg || *endptr != '\0' || options->games < 1) {
+        bail_out(EXIT_FAILURE, "<games> has to be a positive number");
+      }
+      break;
+    case 's':
+      if (solver_strategy_parse(optarg, &options->strategy) != 0) {
+        bail_out(EXIT_FAILURE, "<strategy> has to be one of %s", solver_strategy_list());
+      }
+      break;
+    case 't':
+      options->tree_path = optarg;
+      break;
+    default:
+      bail_out(EXIT_FAILURE, "Usage %s [-f] [-g | -r <token>] [-k] [-l <connections>] [-m <games>] [-s <strategy>] [-t <tree-file>] <server-hostname> <server-port>\n"
+               "      %s -v [-j <threads>] [-m <games>] [-s <strategy>] [-t <tree-file>]\n", progname, progname);
+    }
+  }
+  if (options->keepalive && options->connections == 0) {
+    bail_out(EXIT_FAILURE, "-k keeps the connections of the load generator (-l) alive");
+  }
+  /* the hostname selects the shared memory transport */
+  if (argc - optind == 2) {
+    options->shm_poll = strcmp(argv[optind], SHM_POLL_HOST) == 0;
+    options->shm = options->shm_poll || strcmp(argv[optind], SHM_HOST) == 0;
+  }
+  /* a session plays every secret at most once, shared memory games
+     play the server's secrets */
+  if (options->connections == 0 && !options->shm && options->games > VALID_CODES) {
+    bail_out(EXIT_FAILURE, "<games> has to be in range 1-%ld", (long) VALID_CODES);
+  }
+  if (options->resumable && (options->verify || options->games > 0 || options->connections > 0)) {
+    bail_out(EXIT_FAILURE, "-g and -r resume a single game, without -v, -m and -l");
+  }
+  if (options->verify) {
+    if (argc - optind != 0 || options->framed || options->connections > 0) {
+      bail_out(EXIT_FAILURE, "-v plays in process, without <server-hostname>, <server-port>, -f, -k and -l");
+    }
+    return;
+  }
+  if (argc - optind != 2) {
+    bail_out(EXIT_FAILURE, "Usage %s [-f] [-g | -r <token>] [-k] [-l <connections>] [-m <games>] [-s <strategy>] [-t <tree-file>] <server-hostname> <server-port>\n"
+               "      %s -v [-j <threads>] [-m <games>] [-s <strategy>] [-t <tree-file>]\n", progname, progname); 
   }
   
-  options->hostname = argv[1];
-  port_arg = argv[2];
+  options->hostname = argv[optind];
+  options->port_arg = port_arg = argv[optind + 1];
+  if (options->shm && (options->framed || options->connections > 0)) {
+    bail_out(EXIT_FAILURE, "%s plays the legacy protocol one game at a time, without -f, -g, -k and -l",
+             options->hostname);
+  }
  
   errno = 0; 
   options->port = strtol(port_arg, &endptr, 10);
@@ -433,4 +1696,14 @@ static void free_resources(void) {
   if (ai != NULL) {
     freeaddrinfo(ai);
   }
+  if (shm_channel != NULL) {
+    shm_release(shm_channel);
+    shm_channel = NULL;
+  }
+  if (shm != NULL) {
+    shm_detach(shm);
+    shm = NULL;
+  }
+  solver_shutdown();
+  tree_close(&tree);
 }
@@ -0,0 +1,239 @@
+/**
+ *  mastermind: codeconv
+ *
+ *  @author Thomas Muhm 1326486
+ *
+ *  @brief converts lists of codes between text and the code list format
+ *
+ *  @details
+ *    codeconv <text-file> <code-file> packs a text list with one
+ *    <secret-sequence> per line (like perm.txt) into a code list file
+ *    codeconv -a <code-file> writes the list of all valid codes
+ *    codeconv -d <code-file> prints a code list file as text
+ *
+ *  @date 17.10.2015
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "mastermind.h"
+#include "codelist.h"
+
+/* === Global Variables === */
+
+/* Name of the program */
+static const char *progname = "codeconv";
+
+/* === Prototypes === */
+
+/**
+ * pack_text
+ * @brief Read a text list of codes
+ * @param path The text file
+ * @param count Set to the number of codes
+ * @return The codes, terminates the program on error
+ */
+static code_t *pack_text(const char *path, size_t *count);
+
+/**
+ * all_codes
+ * @brief List all valid codes in ascending order
+ * @param count Set to the number of codes
+ * @return The codes, terminates the program on error
+ */
+static code_t *all_codes(size_t *count);
+
+/**
+ * print_list
+ * @brief Print a code list file as text, one code per line
+ * @param path The code list file
+ */
+static void print_list(const char *path);
+
+/**
+ * usage
+ * @brief Print the usage and terminate
+ */
+static void usage(void);
+
+/**
+ * bail_out
+ * @brief terminate program on program error
+ * @param exitcode exit code
+ * @param fmt format string
+ */
+static void bail_out(int exitcode, const char *fmt, ...);
+
+/* === Implementations === */
+
+static code_t *pack_text(const char *path, size_t *count)
+{
+    char line[64];
+    code_t *codes = NULL;
+    size_t capacity = 0;
+    unsigned long number = 0;
+    FILE *file;
+
+    if ((file = fopen(path, "r")) == NULL) {
+        bail_out(EXIT_FAILURE, "fopen %s", path);
+    }
+    *count = 0;
+    while (fgets(line, sizeof line, file) != NULL) {
+        size_t length = strcspn(line, "\r\n");
+        code_t code = 0;
+
+        number++;
+        if (length == 0) {
+            continue;
+        }
+        if (length != SLOTS) {
+            errno = 0;
+            bail_out(EXIT_FAILURE, "%s:%lu: a code has to be %d chars long",
+                     path, number, SLOTS);
+        }
+        for (int i = 0; i < SLOTS; i++) {
+            const char *color = memchr(COLOR_LETTERS, line[i], COLORS);
+            if (color == NULL) {
+                errno = 0;
+                bail_out(EXIT_FAILURE, "%s:%lu: bad color '%c'", path, number, line[i]);
+            }
+            code |= (code_t) (color - COLOR_LETTERS) << (i * SHIFT_WIDTH);
+        }
+
+        if (*count == capacity) {
+            code_t *grown;
+
+            capacity = capacity > 0 ? capacity * 2 : 1024;
+            if ((grown = realloc(codes, capacity * sizeof *codes)) == NULL) {
+                bail_out(EXIT_FAILURE, "realloc");
+            }
+            codes = grown;
+        }
+        codes[(*count)++] = code;
+    }
+    if (ferror(file)) {
+        bail_out(EXIT_FAILURE, "fgets %s", path);
+    }
+    (void) fclose(file);
+    return codes;
+}
+
+static code_t *all_codes(size_t *count)
+{
+    code_t *codes;
+
+    if ((codes = malloc(VALID_CODES * sizeof *codes)) == NULL) {
+        bail_out(EXIT_FAILURE, "malloc");
+    }
+    for (long i = 0; i < VALID_CODES; i++) {
+        codes[i] = code_from_index(i);
+    }
+    *count = VALID_CODES;
+    return codes;
+}
+
+static void print_list(const char *path)
+{
+    struct codelist list;
+    char text[SLOTS + 1];
+
+    if (codelist_open(path, &list) < 0) {
+        bail_out(EXIT_FAILURE, "Could not load code list %s", path);
+    }
+    text[SLOTS] = '\0';
+    for (size_t i = 0; i < list.count; i++) {
+        uint8_t slots[SLOTS];
+
+        code_to_slots(list.codes[i], slots);
+        for (int s = 0; s < SLOTS; s++) {
+            text[s] = COLOR_LETTERS[slots[s]];
+        }
+        (void) puts(text);
+    }
+    codelist_close(&list);
+}
+
+static void usage(void)
+{
+    (void) fprintf(stderr, "Usage: %s <text-file> <code-file> | -a <code-file> | -d <code-file>\n",
+                   progname);
+    exit(EXIT_FAILURE);
+}
+
+static void bail_out(int exitcode, const char *fmt, ...)
+{
+    va_list ap;
+
+    (void) fprintf(stderr, "%s: ", progname);
+    if (fmt != NULL) {
+        va_start(ap, fmt);
+        (void) vfprintf(stderr, fmt, ap);
+        va_end(ap);
+    }
+    if (errno != 0) {
+        (void) fprintf(stderr, ": %s", strerror(errno));
+    }
+    (void) fprintf(stderr, "\n");
+    exit(exitcode);
+}
+
+/**
+ * main
+ * @brief Program entry point
+ * @param argc The argument counter
+ * @param argv The argument vector
+ * @return EXIT_SUCCESS on success, else EXIT_FAILURE
+ */
+int main(int argc, char *argv[])
+{
+    int all = 0, decode = 0;
+    code_t *codes;
+    size_t count;
+    const char *out;
+    int c;
+
+    if (argc > 0) {
+        progname = argv[0];
+    }
+    while ((c = getopt(argc, argv, "ad")) != -1) {
+        switch (c) {
+        case 'a':
+            all = 1;
+            break;
+        case 'd':
+            decode = 1;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (all + decode > 1 || argc - optind != (all || decode ? 1 : 2)) {
+        usage();
+    }
+
+    if (decode) {
+        print_list(argv[optind]);
+        return EXIT_SUCCESS;
+    }
+    if (all) {
+        codes = all_codes(&count);
+        out = argv[optind];
+    } else {
+        codes = pack_text(argv[optind], &count);
+        out = argv[optind + 1];
+    }
+    if (codelist_write(out, codes, count) < 0) {
+        bail_out(EXIT_FAILURE, "Could not write %s", out);
+    }
+    (void) printf("%s: %lu codes, %lu bytes\n", out, (unsigned long) count,
+                  (unsigned long) (sizeof(struct codelist_header) + count * sizeof *codes));
+    free(codes);
+    return EXIT_SUCCESS;
+}
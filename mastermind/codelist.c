@@ -0,0 +1,132 @@
+/**
+ * @file codelist.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief binary list of packed codes
+ *
+ * @details
+ *    maps code list files written by codelist_write(). The header is
+ *    checked against the game the program was compiled for and every code
+ *    for valid slot values, so users never check a code again
+ *
+ * @date 17.10.2015
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "codelist.h"
+
+/* === Prototypes === */
+
+/**
+ * codelist_valid
+ * @brief Check the header and the codes of a mapped code list file
+ * @param list The list
+ * @return 1 if the list can be used, else 0
+ */
+static int codelist_valid(const struct codelist *list);
+
+/* === Implementations === */
+
+int codelist_open(const char *path, struct codelist *list)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        (void) close(fd);
+        return -1;
+    }
+    if (st.st_size < (off_t) sizeof(struct codelist_header)) {
+        (void) close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    (void) close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    list->header = map;
+    list->codes = (const code_t *) (list->header + 1);
+    list->count = list->header->count;
+    list->size = st.st_size;
+    if (!codelist_valid(list)) {
+        codelist_close(list);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void codelist_close(struct codelist *list)
+{
+    if (list->header != NULL) {
+        (void) munmap((void *) list->header, list->size);
+    }
+    list->header = NULL;
+    list->codes = NULL;
+    list->count = 0;
+    list->size = 0;
+}
+
+int codelist_write(const char *path, const code_t *codes, size_t count)
+{
+    struct codelist_header header;
+    FILE *file;
+
+    if (count == 0 || count > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    (void) memset(&header, 0, sizeof header);
+    (void) memcpy(header.magic, CODELIST_MAGIC, sizeof header.magic);
+    header.version = CODELIST_VERSION;
+    header.slots = SLOTS;
+    header.colors = COLORS;
+    header.code_bytes = sizeof(code_t);
+    header.byte_order = CODELIST_BYTE_ORDER;
+    header.count = count;
+
+    if ((file = fopen(path, "wb")) == NULL) {
+        return -1;
+    }
+    if (fwrite(&header, sizeof header, 1, file) != 1 ||
+        fwrite(codes, sizeof *codes, count, file) != count) {
+        (void) fclose(file);
+        return -1;
+    }
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+static int codelist_valid(const struct codelist *list)
+{
+    const struct codelist_header *header = list->header;
+
+    if (memcmp(header->magic, CODELIST_MAGIC, sizeof header->magic) != 0 ||
+        header->version != CODELIST_VERSION || header->byte_order != CODELIST_BYTE_ORDER ||
+        header->slots != SLOTS || header->colors != COLORS ||
+        header->code_bytes != sizeof(code_t) || header->count == 0 ||
+        (list->size - sizeof *header) / sizeof(code_t) < header->count) {
+        return 0;
+    }
+    for (size_t i = 0; i < list->count; i++) {
+        if ((list->codes[i] & ~(code_t) CODE_MASK) != 0 || !code_valid(list->codes[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
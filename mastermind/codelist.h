@@ -0,0 +1,91 @@
+/**
+ * @file codelist.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief binary list of packed codes
+ *
+ * @details
+ *    replaces the text lists of codes (one <secret-sequence> per line as in
+ *    perm.txt) for the server's secrets, bench solve and the testers. The
+ *    file is a struct codelist_header followed by the codes as code_t,
+ *    without parity bit, in the byte order of the machine that wrote it
+ *    (2 bytes per code for 5x8). It is mapped read only and checked once,
+ *    after that the codes are used in place without any parsing.
+ *    codeconv converts text lists and writes the list of all codes
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef CODELIST_H
+#define CODELIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mastermind.h"
+
+/* === Constants === */
+
+/** first bytes of a code list file */
+#define CODELIST_MAGIC "MMCL"
+
+/** format version of a code list file */
+#define CODELIST_VERSION (1)
+
+/** codelist_header.byte_order as written by the writing machine */
+#define CODELIST_BYTE_ORDER (0x01020304)
+
+/* === Type Definitions === */
+
+/** header of a code list file */
+struct codelist_header {
+    char magic[4];
+    uint8_t version;
+    uint8_t slots;
+    uint8_t colors;
+    /* sizeof(code_t) */
+    uint8_t code_bytes;
+    uint32_t byte_order;
+    /* number of codes following the header */
+    uint32_t count;
+};
+
+/** a mapped code list file */
+struct codelist {
+    const struct codelist_header *header;
+    const code_t *codes;
+    size_t count;
+    size_t size;
+};
+
+/* === Prototypes === */
+
+/**
+ * codelist_open
+ * @brief Map a code list file and check its header and codes
+ * @param path The file
+ * @param list Set to the mapped list
+ * @return 0 on success, -1 on error with errno set (EINVAL if the file is
+ * no code list of this game, is empty or holds an invalid code)
+ */
+int codelist_open(const char *path, struct codelist *list);
+
+/**
+ * codelist_close
+ * @brief Unmap a code list file
+ * @param list The list
+ */
+void codelist_close(struct codelist *list);
+
+/**
+ * codelist_write
+ * @brief Write a code list file
+ * @param path The file
+ * @param codes The codes, without parity bit
+ * @param count Number of codes
+ * @return 0 on success, -1 on error with errno set
+ */
+int codelist_write(const char *path, const code_t *codes, size_t count);
+
+#endif /* CODELIST_H */
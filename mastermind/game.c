@@ -0,0 +1,213 @@
+/**
+ * @file game.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief rules of one mastermind game as played by the server
+ *
+ * @date 17.10.2015
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "score.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define GAME_SSE2 (1)
+#include <emmintrin.h>
+#endif
+
+/* === Constants === */
+
+/* bits of a request covered by its parity bit, including the bit itself */
+#define PARITY_CHECKED (CODE_MASK | ((code_t) 1 << PARITY_BIT))
+
+/* red pins of an answer */
+#define RED_MASK ((1 << SCORE_WHITE_SHIFT) - 1)
+
+/* === Prototypes === */
+
+/**
+ * parity_error
+ * @brief Check the parity bit of a request
+ * @param req The request
+ * @return 1 << PARITY_ERR_BIT if the bit is wrong, else 0
+ */
+static inline uint8_t parity_error(code_t req);
+
+/**
+ * last_round
+ * @brief Mark the answer of round MAX_TRIES as lost unless it won
+ * @param resp The answer, including its parity error flag
+ */
+static inline void last_round(uint8_t *resp);
+
+#ifdef GAME_SSE2
+/**
+ * decode_sse2
+ * @brief game_decode() for adjacent requests, a vector of them at a time
+ * @param requests The first request
+ * @param count Number of requests
+ * @param guesses Array of count guesses
+ * @param errors Array of count flags
+ * @return Number of requests decoded, the rest is left to the caller
+ */
+static size_t decode_sse2(const uint8_t *requests, size_t count,
+                          code_t *guesses, uint8_t *errors);
+#endif
+
+/* === Implementations === */
+
+int compute_answer(code_t req, uint8_t *resp, code_t secret)
+{
+    /* marking red and white */
+    resp[0] = score(req, secret);
+    if (parity_error(req)) {
+        resp[0] |= (1 << PARITY_ERR_BIT);
+        return -1;
+    } else {
+        return resp[0] & 0x7;
+    }
+}
+
+int play_round(int round, code_t req, uint8_t *resp, code_t secret)
+{
+    int correct_guesses = compute_answer(req, resp, secret);
+    if (round == MAX_TRIES && correct_guesses != SLOTS) {
+        resp[0] |= 1 << GAME_LOST_ERR_BIT;
+    }
+    return correct_guesses;
+}
+
+int game_status(uint8_t resp, int correct_guesses)
+{
+    int parity_error = (resp & (1 << PARITY_ERR_BIT)) != 0;
+    int game_lost = (resp & (1 << GAME_LOST_ERR_BIT)) != 0;
+
+    if (parity_error && game_lost) {
+        return EXIT_MULTIPLE_ERRORS;
+    } else if (parity_error) {
+        return EXIT_PARITY_ERROR;
+    } else if (game_lost) {
+        return EXIT_GAME_LOST;
+    } else if (correct_guesses == SLOTS) {
+        return EXIT_SUCCESS;
+    }
+    return GAME_RUNNING;
+}
+
+void game_decode(const uint8_t *requests, size_t stride, size_t count,
+                 code_t *guesses, uint8_t *errors)
+{
+    size_t i = 0;
+
+#ifdef GAME_SSE2
+    if (stride == GUESS_BYTES) {
+        i = decode_sse2(requests, count, guesses, errors);
+    }
+#endif
+    for (; i < count; i++) {
+        code_t req = get_code(requests + i * stride);
+
+        guesses[i] = req & CODE_MASK;
+        errors[i] = parity_error(req);
+    }
+}
+
+void game_rounds(code_t secret, int round, const code_t *guesses, const uint8_t *errors,
+                 size_t count, uint8_t *answers)
+{
+    /* red and white pins do not depend on which code is the guess, so the
+       secret is scored against all guesses with the SIMD kernels */
+    score_codes(secret, guesses, count, answers);
+    for (size_t i = 0; i < count; i++) {
+        answers[i] |= errors[i];
+    }
+    if (round + count > MAX_TRIES) {
+        last_round(&answers[MAX_TRIES - round]);
+    }
+}
+
+void game_answers(const code_t *secrets, const uint8_t *rounds, const code_t *guesses,
+                  const uint8_t *errors, size_t count, uint8_t *answers)
+{
+    score_pairs(guesses, secrets, count, answers);
+    for (size_t i = 0; i < count; i++) {
+        answers[i] |= errors[i];
+        if (rounds[i] == MAX_TRIES) {
+            last_round(&answers[i]);
+        }
+    }
+}
+
+int game_answer_status(uint8_t resp)
+{
+    /* a parity error is reported before the red pins are looked at */
+    return game_status(resp, resp & RED_MASK);
+}
+
+static inline uint8_t parity_error(code_t req)
+{
+    /* the parity bit makes the checked bits even */
+    return __builtin_parityl(req & PARITY_CHECKED) << PARITY_ERR_BIT;
+}
+
+static inline void last_round(uint8_t *resp)
+{
+    if ((*resp & (1 << PARITY_ERR_BIT)) || (*resp & RED_MASK) != SLOTS) {
+        *resp |= 1 << GAME_LOST_ERR_BIT;
+    }
+}
+
+#ifdef GAME_SSE2
+static size_t decode_sse2(const uint8_t *requests, size_t count,
+                          code_t *guesses, uint8_t *errors)
+{
+    size_t i = 0;
+
+#if GUESS_BYTES == 2
+    const __m128i checked = _mm_set1_epi16((short) PARITY_CHECKED);
+    const __m128i slots = _mm_set1_epi16(CODE_MASK);
+    const __m128i one = _mm_set1_epi16(1);
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (requests + i * GUESS_BYTES));
+        __m128i p = _mm_and_si128(x, checked);
+
+        /* fold every lane onto its lowest bit */
+        p = _mm_xor_si128(p, _mm_srli_epi16(p, 8));
+        p = _mm_xor_si128(p, _mm_srli_epi16(p, 4));
+        p = _mm_xor_si128(p, _mm_srli_epi16(p, 2));
+        p = _mm_xor_si128(p, _mm_srli_epi16(p, 1));
+        p = _mm_slli_epi16(_mm_and_si128(p, one), PARITY_ERR_BIT);
+        _mm_storeu_si128((__m128i *) (guesses + i), _mm_and_si128(x, slots));
+        _mm_storel_epi64((__m128i *) (errors + i), _mm_packus_epi16(p, p));
+    }
+#else
+    const __m128i checked = _mm_set1_epi32((int) PARITY_CHECKED);
+    const __m128i slots = _mm_set1_epi32(CODE_MASK);
+    const __m128i one = _mm_set1_epi32(1);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (requests + i * GUESS_BYTES));
+        __m128i p = _mm_and_si128(x, checked);
+        int packed;
+
+        p = _mm_xor_si128(p, _mm_srli_epi32(p, 16));
+        p = _mm_xor_si128(p, _mm_srli_epi32(p, 8));
+        p = _mm_xor_si128(p, _mm_srli_epi32(p, 4));
+        p = _mm_xor_si128(p, _mm_srli_epi32(p, 2));
+        p = _mm_xor_si128(p, _mm_srli_epi32(p, 1));
+        p = _mm_slli_epi32(_mm_and_si128(p, one), PARITY_ERR_BIT);
+        p = _mm_packs_epi32(p, p);
+        packed = _mm_cvtsi128_si32(_mm_packus_epi16(p, p));
+        _mm_storeu_si128((__m128i *) (guesses + i), _mm_and_si128(x, slots));
+        memcpy(errors + i, &packed, sizeof packed);
+    }
+#endif
+    return i;
+}
+#endif
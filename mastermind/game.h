@@ -0,0 +1,116 @@
+/**
+ * @file game.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief rules of one mastermind game as played by the server
+ *
+ * @details
+ *    checks the parity of a guess, scores it against the secret and ends
+ *    the game after MAX_TRIES rounds. Shared by the server and the in
+ *    process benchmarks, so both play by exactly the same rules
+ *
+ *    a batch of requests is decoded and checked in one pass first: a
+ *    request has the right parity bit if the parity of its slot bits and
+ *    the parity bit together is even, so one parity instruction checks it
+ *    (with SSE2 eight or four requests at once). The decoded guesses go to
+ *    one scoring call, score_codes() for the rounds of one game and
+ *    score_pairs() for the rounds of many
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef GAME_H
+#define GAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mastermind.h"
+
+/* === Constants === */
+
+/** game_status() result for a game that is not over yet */
+#define GAME_RUNNING (-1)
+
+/* === Prototypes === */
+
+/**
+ * compute_answer
+ * @brief Compute answer to request
+ * @param req Client's guess
+ * @param resp Buffer that will be sent to the client
+ * @param secret The server's encoded secret
+ * @return Number of correct matches on success; -1 in case of a parity error
+ */
+int compute_answer(code_t req, uint8_t *resp, code_t secret);
+
+/**
+ * play_round
+ * @brief Compute the answer for one round of a game
+ * @param round The current round (1..MAX_TRIES)
+ * @param req Client's guess
+ * @param resp Buffer that will be sent to the client
+ * @param secret The game's encoded secret
+ * @return Number of correct matches on success; -1 in case of a parity error
+ */
+int play_round(int round, code_t req, uint8_t *resp, code_t secret);
+
+/**
+ * game_decode
+ * @brief Decode a batch of requests and check their parity bits
+ * @param requests The first request, GUESS_BYTES little endian each
+ * @param stride Bytes from one request to the next
+ * @param count Number of requests
+ * @param guesses Array of count guesses, set to the slot bits of the requests
+ * @param errors Array of count flags, set to 1 << PARITY_ERR_BIT for a
+ * request with a wrong parity bit, else 0
+ */
+void game_decode(const uint8_t *requests, size_t stride, size_t count,
+                 code_t *guesses, uint8_t *errors);
+
+/**
+ * game_rounds
+ * @brief Answer consecutive rounds of one game, like play_round() for each
+ * @param secret The game's encoded secret
+ * @param round Round of the first guess, count must not go past MAX_TRIES
+ * @param guesses Guesses of game_decode()
+ * @param errors Parity flags of game_decode()
+ * @param count Number of rounds
+ * @param answers Array of count answers, see game_answer_status()
+ */
+void game_rounds(code_t secret, int round, const code_t *guesses, const uint8_t *errors,
+                 size_t count, uint8_t *answers);
+
+/**
+ * game_answers
+ * @brief Answer one round of each of many games, like play_round() for each
+ * @param secrets Encoded secrets of the games
+ * @param rounds Current rounds of the games (1..MAX_TRIES)
+ * @param guesses Guesses of game_decode()
+ * @param errors Parity flags of game_decode()
+ * @param count Number of games
+ * @param answers Array of count answers, see game_answer_status()
+ */
+void game_answers(const code_t *secrets, const uint8_t *rounds, const code_t *guesses,
+                  const uint8_t *errors, size_t count, uint8_t *answers);
+
+/**
+ * game_status
+ * @brief Derive the state of a game from the answer of its last round
+ * @param resp The answer sent to the client
+ * @param correct_guesses Return value of play_round()
+ * @return GAME_RUNNING if the game goes on, else the exit code of the game
+ */
+int game_status(uint8_t resp, int correct_guesses);
+
+/**
+ * game_answer_status
+ * @brief Derive the state of a game from an answer of game_rounds() or
+ * game_answers()
+ * @param resp The answer
+ * @return GAME_RUNNING if the game goes on, else the exit code of the game
+ */
+int game_answer_status(uint8_t resp);
+
+#endif /* GAME_H */
@@ -0,0 +1,221 @@
+/**
+ * @file gametable.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief memory mapped table of the server's resumable games
+ *
+ * @details
+ *    the table is mapped shared, the kernel writes the entries back to the
+ *    file on its own. The lease of an entry doubles as its lock: it is odd
+ *    while a connection writes the entry or copies it out, so a game saved
+ *    or resumed on one connection never mixes with the rounds recorded by
+ *    the connection that lost it. Tokens are published last and read with
+ *    acquire, a token that matches is followed by the game it names
+ *
+ * @date 17.10.2015
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gametable.h"
+#include "secrets.h"
+
+/* === Prototypes === */
+
+/**
+ * gametable_valid
+ * @brief Check the header of a mapped game table file
+ * @param table The table
+ * @return 1 if the table can be used, else 0
+ */
+static int gametable_valid(const struct gametable *table);
+
+/**
+ * gametable_lock
+ * @brief Wait until no one writes a game and lock it
+ * @param game The game
+ * @return The lease before locking, even
+ */
+static uint32_t gametable_lock(struct saved_game *game);
+
+/**
+ * gametable_unlock
+ * @brief Unlock a game
+ * @param game The game
+ * @param lease The lease to leave on the game, even
+ */
+static void gametable_unlock(struct saved_game *game, uint32_t lease);
+
+/* === Implementations === */
+
+int gametable_open(const char *path, struct gametable *table)
+{
+    size_t size = sizeof(struct gametable_header) +
+        (size_t) GAMETABLE_GAMES * sizeof(struct saved_game);
+    struct stat st;
+    void *map;
+    int fd;
+
+    if ((fd = open(path, O_RDWR | O_CREAT, 0600)) < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        (void) close(fd);
+        return -1;
+    }
+    /* a new file is zero filled, its header is written below */
+    if (st.st_size == 0 && ftruncate(fd, size) < 0) {
+        (void) close(fd);
+        return -1;
+    }
+    if (st.st_size != 0 && st.st_size != (off_t) size) {
+        (void) close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    (void) close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    table->header = map;
+    table->games = (struct saved_game *) (table->header + 1);
+    table->size = size;
+    if (st.st_size == 0) {
+        struct gametable_header *header = table->header;
+
+        (void) memcpy(header->magic, GAMETABLE_MAGIC, sizeof header->magic);
+        header->version = GAMETABLE_VERSION;
+        header->slots = SLOTS;
+        header->colors = COLORS;
+        header->code_bytes = sizeof(code_t);
+        header->games = GAMETABLE_GAMES;
+        header->seed = secret_mix((uint64_t) time(NULL) ^ ((uint64_t) getpid() << 32));
+    }
+    if (!gametable_valid(table)) {
+        gametable_close(table);
+        errno = EINVAL;
+        return -1;
+    }
+    /* a server killed while writing a game left it locked */
+    for (int i = 0; i < GAMETABLE_GAMES; i++) {
+        table->games[i].lease &= ~(uint32_t) 1;
+    }
+    return 0;
+}
+
+void gametable_close(struct gametable *table)
+{
+    if (table->header != NULL) {
+        (void) munmap(table->header, table->size);
+    }
+    table->header = NULL;
+    table->games = NULL;
+    table->size = 0;
+}
+
+struct saved_game *gametable_save(struct gametable *table, code_t secret, uint32_t *lease,
+                                  uint64_t *token)
+{
+    uint64_t n = __atomic_fetch_add(&table->header->next, 1, __ATOMIC_RELAXED);
+    uint64_t index = n & (GAMETABLE_GAMES - 1);
+    struct saved_game *game = &table->games[index];
+    uint32_t old = gametable_lock(game);
+
+    /* the old game cannot be resumed from here on */
+    __atomic_store_n(&game->token, 0, __ATOMIC_RELEASE);
+    game->secret = secret;
+    game->played = 0;
+    game->over = 0;
+    /* random bits above the index, never 0 */
+    *token = (secret_mix(table->header->seed ^ n) & ~(uint64_t) (GAMETABLE_GAMES - 1)) |
+        (UINT64_C(1) << 63) | index;
+    __atomic_store_n(&game->token, *token, __ATOMIC_RELEASE);
+    *lease = old + 2;
+    gametable_unlock(game, *lease);
+    return game;
+}
+
+struct saved_game *gametable_resume(struct gametable *table, uint64_t token, uint32_t *lease,
+                                    struct saved_game *copy)
+{
+    struct saved_game *game = &table->games[token & (GAMETABLE_GAMES - 1)];
+    uint32_t old;
+
+    if (token == 0 || __atomic_load_n(&game->token, __ATOMIC_ACQUIRE) != token) {
+        return NULL;
+    }
+    old = gametable_lock(game);
+    /* saved over while waiting for the lock */
+    if (game->token != token) {
+        gametable_unlock(game, old);
+        return NULL;
+    }
+    *copy = *game;
+    *lease = old + 2;
+    gametable_unlock(game, *lease);
+    return game;
+}
+
+void gametable_record(struct saved_game *game, uint32_t lease, const uint8_t *requests,
+                      int count, int over)
+{
+    uint32_t expected = lease;
+
+    /* lock the game only if the lease is still held */
+    if (!__atomic_compare_exchange_n(&game->lease, &expected, lease + 1, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    for (int i = 0; i < count && game->played < MAX_TRIES; i++) {
+        game->guesses[game->played++] = get_code(requests + i * GUESS_BYTES);
+    }
+    game->over = over;
+    gametable_unlock(game, lease);
+}
+
+int gametable_owns(const struct saved_game *game, uint32_t lease)
+{
+    return __atomic_load_n(&game->lease, __ATOMIC_ACQUIRE) == lease;
+}
+
+static uint32_t gametable_lock(struct saved_game *game)
+{
+    for (;;) {
+        uint32_t lease = __atomic_load_n(&game->lease, __ATOMIC_RELAXED);
+
+        if ((lease & 1) == 0 &&
+            __atomic_compare_exchange_n(&game->lease, &lease, lease + 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return lease;
+        }
+        /* held for a few stores, the holder may be preempted */
+        (void) sched_yield();
+    }
+}
+
+static void gametable_unlock(struct saved_game *game, uint32_t lease)
+{
+    __atomic_store_n(&game->lease, lease, __ATOMIC_RELEASE);
+}
+
+static int gametable_valid(const struct gametable *table)
+{
+    const struct gametable_header *header = table->header;
+
+    return memcmp(header->magic, GAMETABLE_MAGIC, sizeof header->magic) == 0 &&
+        header->version == GAMETABLE_VERSION && header->slots == SLOTS &&
+        header->colors == COLORS && header->code_bytes == sizeof(code_t) &&
+        header->games == GAMETABLE_GAMES;
+}
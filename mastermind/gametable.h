@@ -0,0 +1,154 @@
+/**
+ * @file gametable.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief memory mapped table of the server's resumable games
+ *
+ * @details
+ *    the file is a struct gametable_header followed by GAMETABLE_GAMES
+ *    fixed size entries, each one the compact state of a game started with
+ *    FRAME_SAVE: its secret, the rounds played and the guesses as received.
+ *    The answers are not kept, they follow from the secret and the guesses.
+ *    The server plays the games in the mapped entries, so the state of a
+ *    game survives a dropped connection and the server itself exiting or
+ *    being killed, and is still there when the client resumes it
+ *
+ *    new games take the entries in turn, a game is kept until GAMETABLE_GAMES
+ *    newer ones were saved. A token holds the index of its entry in the low
+ *    bits and random bits above. A connection that saves or resumes a game
+ *    takes a lease on it; a game resumed on another connection is no longer
+ *    played on the old one. The lease is odd while the entry is written, so
+ *    the server threads play the games in the mapped entries without
+ *    further locking
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef GAMETABLE_H
+#define GAMETABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mastermind.h"
+
+/* === Constants === */
+
+/** first bytes of a game table file */
+#define GAMETABLE_MAGIC "MMGT"
+
+/** format version of a game table file */
+#define GAMETABLE_VERSION (2)
+
+/** number of entries, a power of two */
+#define GAMETABLE_GAMES (1 << 16)
+
+/* === Type Definitions === */
+
+/** header of a game table file */
+struct gametable_header {
+    char magic[4];
+    uint8_t version;
+    uint8_t slots;
+    uint8_t colors;
+    /* sizeof(code_t) */
+    uint8_t code_bytes;
+    uint32_t games;
+    uint32_t reserved;
+    /* number of games saved so far, the next one takes entry next % games */
+    uint64_t next;
+    /* mixed into the tokens, drawn when the file is created */
+    uint64_t seed;
+};
+
+/** a saved game */
+struct saved_game {
+    /* 0 if the entry was never used */
+    uint64_t token;
+    /* odd while the entry is written, incremented by 2 whenever a
+       connection takes the game */
+    uint32_t lease;
+    /* encoded secret */
+    code_t secret;
+    uint8_t played;
+    /* the last round played ended the game */
+    uint8_t over;
+    /* requests of the rounds played, parity bit included */
+    code_t guesses[MAX_TRIES];
+};
+
+/** a mapped game table file */
+struct gametable {
+    struct gametable_header *header;
+    struct saved_game *games;
+    size_t size;
+};
+
+/* === Prototypes === */
+
+/**
+ * gametable_open
+ * @brief Map a game table file for reading and writing, creating it if it
+ * does not exist
+ * @param path The file
+ * @param table Set to the mapped table
+ * @return 0 on success, -1 on error with errno set (EINVAL if the file is
+ * no game table of this game)
+ */
+int gametable_open(const char *path, struct gametable *table);
+
+/**
+ * gametable_close
+ * @brief Unmap a game table file
+ * @param table The table
+ */
+void gametable_close(struct gametable *table);
+
+/**
+ * gametable_save
+ * @brief Save a new game in the next entry, replacing the oldest game
+ * @param table The table
+ * @param secret The game's encoded secret
+ * @param lease Set to the lease of the caller on the game
+ * @param token Set to the token of the game
+ * @return The game
+ */
+struct saved_game *gametable_save(struct gametable *table, code_t secret, uint32_t *lease,
+                                  uint64_t *token);
+
+/**
+ * gametable_resume
+ * @brief Look up a game by its token and take a lease on it
+ * @param table The table
+ * @param token The token
+ * @param lease Set to the lease of the caller on the game
+ * @param copy Set to the state of the game when the lease was taken, the
+ * entry itself may be written by a connection that takes the game later
+ * @return The game, NULL if no game has this token
+ */
+struct saved_game *gametable_resume(struct gametable *table, uint64_t token, uint32_t *lease,
+                                    struct saved_game *copy);
+
+/**
+ * gametable_record
+ * @brief Append the rounds played by the holder of a lease
+ * @param game The game
+ * @param lease The lease, nothing is recorded if the game was taken since
+ * @param requests count requests of GUESS_BYTES, little endian
+ * @param count Number of rounds
+ * @param over The last of the rounds ended the game
+ */
+void gametable_record(struct saved_game *game, uint32_t lease, const uint8_t *requests,
+                      int count, int over);
+
+/**
+ * gametable_owns
+ * @brief Test if a lease on a game is still held
+ * @param game The game
+ * @param lease The lease
+ * @return 1 if no other connection took the game since, else 0
+ */
+int gametable_owns(const struct saved_game *game, uint32_t lease);
+
+#endif /* GAMETABLE_H */
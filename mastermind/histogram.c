@@ -0,0 +1,70 @@
+/**
+ * @file histogram.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief log-linear latency histogram
+ *
+ * @date 17.10.2015
+ *
+ */
+
+#include "histogram.h"
+
+/* === Prototypes === */
+
+/**
+ * bucket_high
+ * @brief Highest value of a bucket
+ * @param bucket Index of the bucket
+ * @return The value
+ */
+static uint64_t bucket_high(int bucket);
+
+/* === Implementations === */
+
+void histogram_merge(struct histogram *to, const struct histogram *from)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        to->counts[i] += from->counts[i];
+    }
+    to->total += from->total;
+    if (from->max > to->max) {
+        to->max = from->max;
+    }
+}
+
+uint64_t histogram_percentile(const struct histogram *histogram, double percent)
+{
+    uint64_t rank = histogram->total * percent / 100;
+    uint64_t seen = 0;
+
+    if (histogram->total == 0) {
+        return 0;
+    }
+    if (rank >= histogram->total) {
+        rank = histogram->total - 1;
+    }
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen > rank) {
+            uint64_t high = bucket_high(i);
+            /* the bucket may reach beyond the largest value recorded */
+            return high < histogram->max ? high : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+static uint64_t bucket_high(int bucket)
+{
+    int shift;
+    uint64_t mantissa;
+
+    if (bucket < (1 << HISTOGRAM_SUB_BITS)) {
+        return bucket;
+    }
+    shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    mantissa = bucket % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file histogram.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief log-linear latency histogram
+ *
+ * @details
+ *    values below 2^HISTOGRAM_SUB_BITS get a bucket each, above that every
+ *    power of two is split into 2^(HISTOGRAM_SUB_BITS - 1) buckets, so a
+ *    percentile is off by at most 1/16 of its value. Recording is an index
+ *    computation and an increment, the counts of several histograms (e.g.
+ *    one per thread) are merged for reporting
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/* === Constants === */
+
+/** bits of a value kept exactly */
+#define HISTOGRAM_SUB_BITS (5)
+
+/** buckets per power of two above 2^HISTOGRAM_SUB_BITS */
+#define HISTOGRAM_SUB_BUCKETS (1 << (HISTOGRAM_SUB_BITS - 1))
+
+/** number of buckets, enough for any 64 bit value */
+#define HISTOGRAM_BUCKETS ((66 - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_BUCKETS)
+
+/* === Type Definitions === */
+
+/** counts of the recorded values */
+struct histogram {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+};
+
+/* === Prototypes === */
+
+/**
+ * histogram_merge
+ * @brief Add the counts of a histogram to another one
+ * @param to The histogram added to
+ * @param from The histogram added
+ */
+void histogram_merge(struct histogram *to, const struct histogram *from);
+
+/**
+ * histogram_percentile
+ * @brief Value below or at which a share of the recorded values lies
+ * @param histogram The histogram
+ * @param percent The share in percent, 0 to 100
+ * @return Highest value of the bucket holding the percentile, 0 if nothing
+ * was recorded
+ */
+uint64_t histogram_percentile(const struct histogram *histogram, double percent);
+
+/**
+ * histogram_bucket
+ * @brief Bucket of a value
+ * @param value The value
+ * @return The index of the bucket
+ */
+static inline int histogram_bucket(uint64_t value)
+{
+    int msb, shift;
+
+    if (value < (1 << HISTOGRAM_SUB_BITS)) {
+        return value;
+    }
+    msb = 63 - __builtin_clzll(value);
+    shift = msb - HISTOGRAM_SUB_BITS + 1;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (value >> shift) - HISTOGRAM_SUB_BUCKETS;
+}
+
+/**
+ * histogram_record
+ * @brief Count a value
+ * @param histogram The histogram
+ * @param value The value
+ */
+static inline void histogram_record(struct histogram *histogram, uint64_t value)
+{
+    histogram->counts[histogram_bucket(value)]++;
+    histogram->total++;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,368 @@
+/**
+ * @file mastermind.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief shared game constants and wire protocol of the mastermind client and server
+ *
+ * @details
+ *    the size of the game is fixed at compile time, SLOTS and COLORS may be
+ *    overridden with -D (make SLOTS=6 COLORS=10). A code packs one color
+ *    per slot into SHIFT_WIDTH bits, slot 0 lowest.
+ *
+ *    legacy protocol: the client sends a GUESS_BYTES guess (the packed code,
+ *    parity in the highest bit: 2 bytes and bit 15 for the classic 5 slots
+ *    of 3 bits, 4 bytes and bit 31 for codes wider than 15 bits), the server
+ *    answers with 1 byte (red pins in bits 0-2, white pins in bits 3-5,
+ *    parity error bit 6, game lost bit 7)
+ *
+ *    framed protocol: instead of its first guess a client sends PROTO_HELLO,
+ *    the server acknowledges with a single byte holding PROTO_VERSION. After
+ *    that both sides exchange frames of a FRAME_HEADER_BYTES header followed
+ *    by `count` entries; a request frame may carry several guesses, the
+ *    response frame carries one answer byte per played guess
+ *
+ *    sessions: FRAME_OPEN and FRAME_PLAY entries are tagged with a 16 bit
+ *    game id, so one connection can play many games against different
+ *    secrets at the same time. An id is free again once its game is over
+ *
+ *    keep-alive: a FRAME_NEW request starts a new game of the connection
+ *    (the one FRAME_GUESSES plays) and gives up the running one. Once a
+ *    client sent it, the server keeps the connection open when a game is
+ *    over, so a client may play game after game without a new handshake.
+ *    FRAME_NEW and the first FRAME_GUESSES of the game may be sent at once
+ *
+ *    resume: FRAME_SAVE starts a game like FRAME_NEW and has the server
+ *    keep it in its game table under a token. When the connection drops, a
+ *    client sends the token with FRAME_RESUME on a new connection, the game
+ *    becomes that connection's game and the response lists the rounds the
+ *    server played, so the client can rebuild its state from them
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef MASTERMIND_H
+#define MASTERMIND_H
+
+#include <stdint.h>
+
+/* === Constants === */
+
+/** number of guesses until the game is lost */
+#define MAX_TRIES (35)
+
+/** number of slots of a code */
+#ifndef SLOTS
+#define SLOTS (5)
+#endif
+
+/** number of colors per slot */
+#ifndef COLORS
+#define COLORS (8)
+#endif
+
+/** bits per slot in the encoded guess */
+#if COLORS < 2 || COLORS > 16
+#error "COLORS has to be in range 2-16"
+#elif COLORS <= 8
+#define SHIFT_WIDTH (3)
+#else
+#define SHIFT_WIDTH (4)
+#endif
+
+/* red and white pins have 3 bits each in the answer */
+#if SLOTS < 2 || SLOTS > 7
+#error "SLOTS has to be in range 2-7"
+#endif
+
+/** mask of one slot of an encoded guess */
+#define SLOT_MASK ((1 << SHIFT_WIDTH) - 1)
+
+/** bits of an encoded guess without the parity bit */
+#define CODE_BITS (SLOTS * SHIFT_WIDTH)
+
+/** size of a guess on the wire, the parity bit is its highest bit */
+#if CODE_BITS <= 15
+#define GUESS_BYTES (2)
+typedef uint16_t code_t;
+#else
+#define GUESS_BYTES (4)
+typedef uint32_t code_t;
+#endif
+
+/** number of packed codes, including those with a slot value >= COLORS */
+#define CODES (1 << CODE_BITS)
+
+/** number of valid codes, COLORS to the power of SLOTS */
+#define VALID_CODES (COLORS * COLORS * (SLOTS > 2 ? COLORS : 1) * (SLOTS > 3 ? COLORS : 1) * \
+                     (SLOTS > 4 ? COLORS : 1) * (SLOTS > 5 ? COLORS : 1) * (SLOTS > 6 ? COLORS : 1))
+
+/** mask of the slot bits of an encoded guess */
+#define CODE_MASK (CODES - 1)
+
+/** parity bit of the encoded guess */
+#define PARITY_BIT (GUESS_BYTES * 8 - 1)
+
+/** letters of the colors in a <secret-sequence>, the first COLORS are used */
+#define COLOR_LETTERS "bdgorsvwypcklmnt"
+
+/** answer bit set if the guess had a parity error */
+#define PARITY_ERR_BIT (6)
+
+/** answer bit set if the game is lost */
+#define GAME_LOST_ERR_BIT (7)
+
+#define EXIT_PARITY_ERROR (2)
+#define EXIT_GAME_LOST (3)
+#define EXIT_MULTIPLE_ERRORS (4)
+
+/** size of an answer on the wire */
+#define ANSWER_BYTES (1)
+
+/* === Framed protocol === */
+
+/** highest framed protocol version understood */
+#define PROTO_VERSION (1)
+
+/**
+ * hello sent in place of the first guess. Read as a legacy guess of either
+ * width it has a wrong parity bit, so a correct legacy client never sends
+ * it and a legacy server answers it with a parity error.
+ */
+#define PROTO_HELLO (0x816d)
+
+/** frame header: type, reserved, count (16 bit, little endian) */
+#define FRAME_HEADER_BYTES (4)
+
+/** maximum number of entries per frame */
+#define FRAME_MAX_COUNT (1024)
+
+/** request: `count` guesses for the connection's game, response: `count` answers */
+#define FRAME_GUESSES (1)
+
+/** request: (game id, secret) entries, response: (game id, OPEN_* status) entries */
+#define FRAME_OPEN (2)
+
+/** request: (game id, guess) entries, response: (game id, answer) entries */
+#define FRAME_PLAY (3)
+
+/** request: 1 secret of the next game, response: 1 OPEN_* status */
+#define FRAME_NEW (4)
+
+/** request: 1 secret of the next game, response: 1 SAVE_RESP_BYTES entry, an
+    OPEN_* status and the token of the saved game */
+#define FRAME_SAVE (5)
+
+/** request: 1 token, response: 1 RESUME_ENTRY_BYTES entry with a RESUME_*
+    status as answer, then 1 (guess, answer) entry per round played */
+#define FRAME_RESUME (6)
+
+/** size of a token, a 64 bit little endian value */
+#define RESUME_TOKEN_BYTES (8)
+
+/** size of a FRAME_SAVE response entry */
+#define SAVE_RESP_BYTES (ANSWER_BYTES + RESUME_TOKEN_BYTES)
+
+/** size of a FRAME_RESUME response entry: guess and answer */
+#define RESUME_ENTRY_BYTES (GUESS_BYTES + ANSWER_BYTES)
+
+/** size of a FRAME_OPEN or FRAME_PLAY request entry: game id and secret or guess */
+#define SESSION_REQ_BYTES (2 + GUESS_BYTES)
+
+/** size of a FRAME_OPEN or FRAME_PLAY response entry */
+#define SESSION_RESP_BYTES (3)
+
+/** secret of a FRAME_OPEN or FRAME_NEW entry: play against the server's own secret */
+#define SECRET_SERVER ((code_t) 1 << PARITY_BIT)
+
+/** FRAME_OPEN status: game opened */
+#define OPEN_OK (0)
+
+/** FRAME_OPEN status: game id already in use */
+#define OPEN_IN_USE (1)
+
+/** FRAME_SAVE status: the game was started, but the server keeps no game
+    table (the token is 0) */
+#define OPEN_NO_SAVE (2)
+
+/** FRAME_RESUME status: the game goes on */
+#define RESUME_RUNNING (0)
+
+/** FRAME_RESUME status: the last round listed ended the game */
+#define RESUME_OVER (1)
+
+/** FRAME_RESUME status: no saved game has this token */
+#define RESUME_UNKNOWN (2)
+
+/** FRAME_PLAY answer for a game id that is not open, FRAME_GUESSES answer
+    after the game of a kept alive connection is over or was resumed on
+    another connection, shared memory answer after the game of a channel is
+    over (red and white 7) */
+#define ANSWER_NO_GAME (0xff)
+
+/* === Functions === */
+
+/**
+ * get16
+ * @brief Read a 16 bit little endian value
+ * @param buffer Buffer to read from
+ * @return The value
+ */
+static inline uint16_t get16(const uint8_t *buffer)
+{
+    return buffer[0] | (buffer[1] << 8);
+}
+
+/**
+ * put16
+ * @brief Write a 16 bit little endian value
+ * @param buffer Buffer to write to
+ * @param value The value
+ */
+static inline void put16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = value & 0xff;
+    buffer[1] = value >> 8;
+}
+
+/**
+ * get64
+ * @brief Read a 64 bit little endian value
+ * @param buffer Buffer to read from
+ * @return The value
+ */
+static inline uint64_t get64(const uint8_t *buffer)
+{
+    uint64_t value = 0;
+
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | buffer[i];
+    }
+    return value;
+}
+
+/**
+ * put64
+ * @brief Write a 64 bit little endian value
+ * @param buffer Buffer to write to
+ * @param value The value
+ */
+static inline void put64(uint8_t *buffer, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        buffer[i] = (value >> (i * 8)) & 0xff;
+    }
+}
+
+/**
+ * get_code
+ * @brief Read a little endian guess or secret of GUESS_BYTES
+ * @param buffer Buffer to read from
+ * @return The value
+ */
+static inline code_t get_code(const uint8_t *buffer)
+{
+    code_t value = 0;
+
+    for (int i = GUESS_BYTES - 1; i >= 0; i--) {
+        value = (value << 8) | buffer[i];
+    }
+    return value;
+}
+
+/**
+ * put_code
+ * @brief Write a little endian guess or secret of GUESS_BYTES
+ * @param buffer Buffer to write to
+ * @param value The value
+ */
+static inline void put_code(uint8_t *buffer, code_t value)
+{
+    for (int i = 0; i < GUESS_BYTES; i++) {
+        buffer[i] = (value >> (i * 8)) & 0xff;
+    }
+}
+
+/**
+ * frame_header
+ * @brief Write a frame header
+ * @param buffer Buffer of at least FRAME_HEADER_BYTES
+ * @param type Frame type
+ * @param count Number of entries
+ */
+static inline void frame_header(uint8_t *buffer, uint8_t type, uint16_t count)
+{
+    buffer[0] = type;
+    buffer[1] = 0;
+    put16(&buffer[2], count);
+}
+
+/**
+ * frame_count
+ * @brief Read the entry count of a frame header
+ * @param buffer Frame header
+ * @return Number of entries
+ */
+static inline uint16_t frame_count(const uint8_t *buffer)
+{
+    return get16(&buffer[2]);
+}
+
+/**
+ * code_to_slots
+ * @brief Unpack an encoded code (SHIFT_WIDTH bits per slot) into colors
+ * @param code The code, bits above the slots are ignored
+ * @param slots Array of SLOTS colors
+ */
+static inline void code_to_slots(code_t code, uint8_t *slots)
+{
+    for (int i = 0; i < SLOTS; i++) {
+        slots[i] = (code >> (i * SHIFT_WIDTH)) & SLOT_MASK;
+    }
+}
+
+/**
+ * code_valid
+ * @brief Test if every slot of a code holds one of the COLORS
+ * @param code The code, bits above the slots are ignored
+ * @return 1 if valid, else 0
+ */
+static inline int code_valid(code_t code)
+{
+    for (int i = 0; i < SLOTS; i++) {
+        if (((code >> (i * SHIFT_WIDTH)) & SLOT_MASK) >= COLORS) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * code_from_index
+ * @brief The index-th valid code in ascending order
+ * @param index Index in range 0 to VALID_CODES - 1
+ * @return The encoded code
+ */
+static inline code_t code_from_index(long index)
+{
+    code_t code = 0;
+
+    for (int i = 0; i < SLOTS; i++) {
+        code |= (code_t) (index % COLORS) << (i * SHIFT_WIDTH);
+        index /= COLORS;
+    }
+    return code;
+}
+
+/**
+ * code_parity
+ * @brief Parity of the slot bits of a code
+ * @param code The code, bits above the slots are ignored
+ * @return 0 or 1
+ */
+static inline int code_parity(code_t code)
+{
+    return __builtin_parityl(code & CODE_MASK);
+}
+
+#endif /* MASTERMIND_H */
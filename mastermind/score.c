@@ -0,0 +1,530 @@
+/**
+ * @file score.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief red/white scoring shared by the mastermind client and server
+ *
+ * @details
+ *    builds the score tables described in score.h. For the classic 5x8 game
+ *    the tables are aligned to cache lines and take about 700 KiB, most of
+ *    it score_matches. The SIMD kernels are compiled with target attributes,
+ *    so the file needs no -m flags and runs on CPUs without AVX2
+ *
+ * @date 17.10.2015
+ *
+ */
+
+#include <string.h>
+
+#include "score.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCORE_X86 (1)
+#include <immintrin.h>
+#endif
+
+/* the SIMD kernels work on the 16 bit codes of the table games */
+#if defined(SCORE_X86) && defined(SCORE_TABLES)
+#define SCORE_SIMD (1)
+#endif
+
+/* === Constants === */
+
+/* size of a cache line */
+#define CACHE_LINE (64)
+
+/* codes per word of a score_filter() bitset */
+#define WORD_BITS (64)
+
+/* maximum number of words score_filter() scores with one kernel call */
+#define FILTER_RUN_WORDS (16)
+
+/* codes score_row() scores with one kernel call */
+#define ROW_BLOCK_CODES (1024)
+
+/* score_codes() uses the table lookups for fewer codes */
+#define SIMD_MIN_CODES (32)
+
+/* marks a multiset key that has no index yet */
+#define NO_MULTISET (0xffff)
+
+/* === Global Variables === */
+
+uint64_t score_valid[CODES / 64] __attribute__((aligned(CACHE_LINE)));
+
+#ifdef SCORE_TABLES
+uint8_t score_red[CODES] __attribute__((aligned(CACHE_LINE)));
+
+uint16_t score_multiset[CODES] __attribute__((aligned(CACHE_LINE)));
+
+uint8_t score_matches[SCORE_MULTISETS][SCORE_MULTISETS] __attribute__((aligned(CACHE_LINE)));
+
+/* every code once, input of score_row() and score_filter() for the SIMD kernels */
+static code_t all_codes[CODES] __attribute__((aligned(CACHE_LINE)));
+#endif
+
+#ifdef SCORE_SWAR
+uint64_t score_color_field[1 << SHIFT_WIDTH];
+
+uint64_t score_color_one[1 << SHIFT_WIDTH];
+#endif
+
+/* kernel used by score_codes() */
+static enum score_kernel selected = SCORE_KERNEL_SCALAR;
+
+/* === Type Definitions === */
+
+/* the guess unpacked for the SIMD kernels */
+struct guess_colors {
+    /* number of distinct colors of the guess */
+    int count;
+    /* the distinct colors and how often the guess uses them */
+    uint8_t color[SLOTS];
+    uint8_t times[SLOTS];
+};
+
+/* === Prototypes === */
+
+#ifdef SCORE_TABLES
+/**
+ * init_tables
+ * @brief Build score_red, score_multiset and score_matches
+ */
+static void init_tables(void);
+#endif
+
+/**
+ * score_codes_scalar
+ * @brief score_codes() without SIMD
+ */
+static void score_codes_scalar(code_t guess, const code_t *codes, size_t n, uint8_t *scores);
+
+#ifdef SCORE_TABLES
+/**
+ * match_mask
+ * @brief Compare WORD_BITS scores with one score
+ * @param scores Array of WORD_BITS scores
+ * @param score The score to compare with
+ * @return Bitmask, bit i set if scores[i] == score
+ */
+static uint64_t match_mask(const uint8_t *scores, uint8_t score);
+#endif
+
+#ifdef SCORE_SIMD
+/**
+ * unpack_guess
+ * @brief Collect the distinct colors of a guess
+ * @param guess The encoded guess
+ * @param colors Set to the colors of the guess
+ */
+static void unpack_guess(code_t guess, struct guess_colors *colors);
+
+/**
+ * score_codes_sse2
+ * @brief score_codes() for 8 codes per instruction
+ */
+static void score_codes_sse2(code_t guess, const code_t *codes, size_t n, uint8_t *scores);
+
+/**
+ * score_codes_avx2
+ * @brief score_codes() for 16 codes per instruction
+ */
+static void score_codes_avx2(code_t guess, const code_t *codes, size_t n, uint8_t *scores);
+#endif
+
+/* === Implementations === */
+
+void score_init(void)
+{
+    (void) memset(score_valid, 0, sizeof score_valid);
+    for (long code = 0; code < CODES; code++) {
+        if (code_valid(code)) {
+            score_valid[code / 64] |= (uint64_t) 1 << (code % 64);
+        }
+    }
+
+#ifdef SCORE_TABLES
+    init_tables();
+#endif
+#ifdef SCORE_SWAR
+    for (int c = 0; c < COLORS; c++) {
+        score_color_one[c] = (uint64_t) 1 << (c * SLOTS);
+        score_color_field[c] = (((uint64_t) 1 << SLOTS) - 1) << (c * SLOTS);
+    }
+#endif
+
+    /* pick the fastest kernel: the table lookups beat the SSE2 kernel, it
+       is only used if selected explicitly */
+    if (score_select(SCORE_KERNEL_AVX2) < 0) {
+        (void) score_select(SCORE_KERNEL_SCALAR);
+    }
+}
+
+#ifdef SCORE_TABLES
+static void init_tables(void)
+{
+    /* multiset key (slot values sorted, packed like a code) to multiset index */
+    static uint16_t key_index[CODES];
+    static uint8_t histogram[SCORE_MULTISETS][1 << SHIFT_WIDTH];
+    int multisets = 0;
+
+    for (int x = 0; x < CODES; x++) {
+        uint8_t red = 0;
+        for (int i = 0; i < SLOTS; i++) {
+            if (((x >> (i * SHIFT_WIDTH)) & SLOT_MASK) == 0) {
+                red++;
+            }
+        }
+        score_red[x] = red;
+    }
+
+    (void) memset(key_index, 0xff, sizeof key_index);
+    for (int code = 0; code < CODES; code++) {
+        uint8_t slots[SLOTS];
+        uint16_t key = 0;
+
+        /* insertion sort of the slot values */
+        code_to_slots(code, slots);
+        for (int i = 1; i < SLOTS; i++) {
+            uint8_t c = slots[i];
+            int j = i;
+            while (j > 0 && slots[j - 1] > c) {
+                slots[j] = slots[j - 1];
+                j--;
+            }
+            slots[j] = c;
+        }
+        for (int i = 0; i < SLOTS; i++) {
+            key |= slots[i] << (i * SHIFT_WIDTH);
+        }
+
+        if (key_index[key] == NO_MULTISET) {
+            key_index[key] = multisets;
+            (void) memset(histogram[multisets], 0, sizeof histogram[multisets]);
+            for (int i = 0; i < SLOTS; i++) {
+                histogram[multisets][slots[i]]++;
+            }
+            multisets++;
+        }
+        score_multiset[code] = key_index[key];
+        all_codes[code] = code;
+    }
+
+    for (int a = 0; a < multisets; a++) {
+        for (int b = 0; b < multisets; b++) {
+            uint8_t matches = 0;
+            for (int c = 0; c < (1 << SHIFT_WIDTH); c++) {
+                matches += histogram[a][c] < histogram[b][c] ? histogram[a][c] : histogram[b][c];
+            }
+            score_matches[a][b] = matches;
+        }
+    }
+}
+#endif
+
+int score_select(enum score_kernel kernel)
+{
+    switch (kernel) {
+    case SCORE_KERNEL_SCALAR:
+        break;
+#ifdef SCORE_SIMD
+    case SCORE_KERNEL_SSE2:
+        if (!__builtin_cpu_supports("sse2")) {
+            return -1;
+        }
+        break;
+    case SCORE_KERNEL_AVX2:
+        if (!__builtin_cpu_supports("avx2")) {
+            return -1;
+        }
+        break;
+#endif
+    default:
+        return -1;
+    }
+    selected = kernel;
+    return 0;
+}
+
+const char *score_kernel_name(enum score_kernel kernel)
+{
+    switch (kernel) {
+    case SCORE_KERNEL_SSE2:
+        return "sse2";
+    case SCORE_KERNEL_AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+enum score_kernel score_selected(void)
+{
+    return selected;
+}
+
+void score_codes(code_t guess, const code_t *codes, size_t n, uint8_t *scores)
+{
+    /* too few codes to pay for unpacking the guess */
+    if (n < SIMD_MIN_CODES) {
+        score_codes_scalar(guess, codes, n, scores);
+        return;
+    }
+    switch (selected) {
+#ifdef SCORE_SIMD
+    case SCORE_KERNEL_AVX2:
+        score_codes_avx2(guess, codes, n, scores);
+        break;
+    case SCORE_KERNEL_SSE2:
+        score_codes_sse2(guess, codes, n, scores);
+        break;
+#endif
+    default:
+        score_codes_scalar(guess, codes, n, scores);
+        break;
+    }
+}
+
+void score_pairs(const code_t *guesses, const code_t *secrets, size_t n, uint8_t *scores)
+{
+#if defined(SCORE_TABLES)
+    /* no lookup depends on another pair, so the loads of consecutive pairs overlap */
+    for (size_t i = 0; i < n; i++) {
+        uint8_t red = score_red[guesses[i] ^ secrets[i]];
+        uint8_t matches = score_matches[score_multiset[guesses[i]]][score_multiset[secrets[i]]];
+        scores[i] = red | ((matches - red) << SCORE_WHITE_SHIFT);
+    }
+#else
+    for (size_t i = 0; i < n; i++) {
+        scores[i] = score(guesses[i], secrets[i]);
+    }
+#endif
+}
+
+void score_row(code_t code, uint8_t *row)
+{
+#ifdef SCORE_TABLES
+    score_codes(code, all_codes, CODES, row);
+#else
+    /* only the valid codes, most packed codes of a wide game are not */
+    code_t block[ROW_BLOCK_CODES];
+    uint8_t scores[ROW_BLOCK_CODES];
+    long w = 0;
+
+    while (w < CODES / WORD_BITS) {
+        int n = 0;
+
+        for (; w < CODES / WORD_BITS && n + WORD_BITS <= ROW_BLOCK_CODES; w++) {
+            for (uint64_t valid = score_valid[w]; valid != 0; valid &= valid - 1) {
+                block[n++] = w * WORD_BITS + __builtin_ctzll(valid);
+            }
+        }
+        score_codes(code, block, n, scores);
+        for (int i = 0; i < n; i++) {
+            row[block[i]] = scores[i];
+        }
+    }
+#endif
+}
+
+void score_filter(code_t guess, uint8_t wanted, uint64_t *bits)
+{
+#ifdef SCORE_TABLES
+    uint8_t scores[FILTER_RUN_WORDS * WORD_BITS] __attribute__((aligned(CACHE_LINE)));
+    int w = 0;
+
+    while (w < CODES / WORD_BITS) {
+        int run = 0;
+
+        if (bits[w] == 0) {
+            w++;
+            continue;
+        }
+        /* score runs of non-empty words at once, so the kernel setup is amortized */
+        while (run < FILTER_RUN_WORDS && w + run < CODES / WORD_BITS && bits[w + run] != 0) {
+            run++;
+        }
+        score_codes(guess, all_codes + w * WORD_BITS, run * WORD_BITS, scores);
+        for (int i = 0; i < run; i++) {
+            bits[w + i] &= match_mask(scores + i * WORD_BITS, wanted);
+        }
+        w += run;
+    }
+#else
+    /* no kernel to feed, score the set bits only */
+    for (long w = 0; w < CODES / WORD_BITS; w++) {
+        for (uint64_t set = bits[w]; set != 0; set &= set - 1) {
+            int bit = __builtin_ctzll(set);
+            if (score(guess, w * WORD_BITS + bit) != wanted) {
+                bits[w] &= ~((uint64_t) 1 << bit);
+            }
+        }
+    }
+#endif
+}
+
+#ifdef SCORE_TABLES
+static uint64_t match_mask(const uint8_t *scores, uint8_t score)
+{
+    uint64_t mask = 0;
+#if defined(SCORE_X86) && defined(__SSE2__)
+    /* compare 16 bytes at once, movemask gathers the results as bits */
+    const __m128i vscore = _mm_set1_epi8(score);
+
+    for (int i = 0; i < WORD_BITS; i += 16) {
+        __m128i s = _mm_load_si128((const __m128i *) (scores + i));
+        uint64_t bits = (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(s, vscore));
+        mask |= bits << i;
+    }
+#else
+    for (int i = 0; i < WORD_BITS; i++) {
+        mask |= (uint64_t) (scores[i] == score) << i;
+    }
+#endif
+    return mask;
+}
+#endif
+
+static void score_codes_scalar(code_t guess, const code_t *codes, size_t n, uint8_t *scores)
+{
+#if defined(SCORE_TABLES)
+    const uint8_t *matches = score_matches[score_multiset[guess & CODE_MASK]];
+
+    guess &= CODE_MASK;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t red = score_red[guess ^ codes[i]];
+        scores[i] = red | ((matches[score_multiset[codes[i]]] - red) << SCORE_WHITE_SHIFT);
+    }
+#elif defined(SCORE_SWAR)
+    /* the color word of the guess is the same for every code */
+    uint64_t colors = score_colors(guess);
+
+    for (size_t i = 0; i < n; i++) {
+        uint8_t red = score_red_pins(guess, codes[i]);
+        uint8_t matches = score_bits(colors & score_colors(codes[i]));
+        scores[i] = red | ((matches - red) << SCORE_WHITE_SHIFT);
+    }
+#else
+    for (size_t i = 0; i < n; i++) {
+        scores[i] = score(guess, codes[i]);
+    }
+#endif
+}
+
+#ifdef SCORE_SIMD
+static void unpack_guess(code_t guess, struct guess_colors *colors)
+{
+    uint8_t slots[SLOTS];
+
+    code_to_slots(guess, slots);
+    colors->count = 0;
+    for (int j = 0; j < SLOTS; j++) {
+        int k;
+        for (k = 0; k < colors->count && colors->color[k] != slots[j]; k++) {
+            /* search color */
+        }
+        if (k == colors->count) {
+            colors->color[k] = slots[j];
+            colors->times[k] = 0;
+            colors->count++;
+        }
+        colors->times[k]++;
+    }
+}
+
+/*
+ * Bit-sliced slot counting: for x = code ^ (a color in every slot), fold
+ * every 3 bit slot onto its lowest bit (x | x >> 1 | x >> 2, masked with
+ * SLOT_LOW_BITS) to flag the slots that differ. Multiplying by
+ * SLOT_LOW_BITS sums the flags of all slots into the highest slot, so
+ * SLOTS - that sum is the number of slots holding the color.
+ */
+#define SLOT_SUM_SHIFT ((SLOTS - 1) * SHIFT_WIDTH)
+
+__attribute__((target("sse2")))
+static void score_codes_sse2(code_t guess, const code_t *codes, size_t n, uint8_t *scores)
+{
+    struct guess_colors colors;
+    __m128i color[SLOTS], times[SLOTS];
+    const __m128i low = _mm_set1_epi16(SLOT_LOW_BITS);
+    const __m128i slot = _mm_set1_epi16(SLOT_MASK);
+    const __m128i slots = _mm_set1_epi16(SLOTS);
+    const __m128i vguess = _mm_set1_epi16(guess & CODE_MASK);
+    size_t i = 0;
+
+    unpack_guess(guess, &colors);
+    for (int k = 0; k < colors.count; k++) {
+        color[k] = _mm_set1_epi16(colors.color[k] * SLOT_LOW_BITS);
+        times[k] = _mm_set1_epi16(colors.times[k]);
+    }
+
+#define EQUAL_SLOTS_SSE2(x) \
+    _mm_sub_epi16(slots, _mm_and_si128(_mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128( \
+        _mm_or_si128(_mm_or_si128((x), _mm_srli_epi16((x), 1)), _mm_srli_epi16((x), 2)), \
+        low), low), SLOT_SUM_SHIFT), slot))
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i code = _mm_loadu_si128((const __m128i *) (codes + i));
+        __m128i diff = _mm_xor_si128(code, vguess);
+        __m128i red = EQUAL_SLOTS_SSE2(diff);
+        __m128i matches = _mm_setzero_si128();
+
+        /* min(times in guess, times in code) over the colors of the guess */
+        for (int k = 0; k < colors.count; k++) {
+            __m128i x = _mm_xor_si128(code, color[k]);
+            matches = _mm_add_epi16(matches, _mm_min_epi16(EQUAL_SLOTS_SSE2(x), times[k]));
+        }
+
+        __m128i s = _mm_or_si128(red, _mm_slli_epi16(_mm_sub_epi16(matches, red), SCORE_WHITE_SHIFT));
+        _mm_storel_epi64((__m128i *) (scores + i), _mm_packus_epi16(s, s));
+    }
+#undef EQUAL_SLOTS_SSE2
+    score_codes_scalar(guess, codes + i, n - i, scores + i);
+}
+
+__attribute__((target("avx2")))
+static void score_codes_avx2(code_t guess, const code_t *codes, size_t n, uint8_t *scores)
+{
+    struct guess_colors colors;
+    __m256i color[SLOTS], times[SLOTS];
+    const __m256i low = _mm256_set1_epi16(SLOT_LOW_BITS);
+    const __m256i slot = _mm256_set1_epi16(SLOT_MASK);
+    const __m256i slots = _mm256_set1_epi16(SLOTS);
+    const __m256i vguess = _mm256_set1_epi16(guess & CODE_MASK);
+    size_t i = 0;
+
+    unpack_guess(guess, &colors);
+    for (int k = 0; k < colors.count; k++) {
+        color[k] = _mm256_set1_epi16(colors.color[k] * SLOT_LOW_BITS);
+        times[k] = _mm256_set1_epi16(colors.times[k]);
+    }
+
+#define EQUAL_SLOTS_AVX2(x) \
+    _mm256_sub_epi16(slots, _mm256_and_si256(_mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256( \
+        _mm256_or_si256(_mm256_or_si256((x), _mm256_srli_epi16((x), 1)), _mm256_srli_epi16((x), 2)), \
+        low), low), SLOT_SUM_SHIFT), slot))
+
+    for (; i + 16 <= n; i += 16) {
+        __m256i code = _mm256_loadu_si256((const __m256i *) (codes + i));
+        __m256i diff = _mm256_xor_si256(code, vguess);
+        __m256i red = EQUAL_SLOTS_AVX2(diff);
+        __m256i matches = _mm256_setzero_si256();
+
+        /* min(times in guess, times in code) over the colors of the guess */
+        for (int k = 0; k < colors.count; k++) {
+            __m256i x = _mm256_xor_si256(code, color[k]);
+            matches = _mm256_add_epi16(matches, _mm256_min_epi16(EQUAL_SLOTS_AVX2(x), times[k]));
+        }
+
+        __m256i s = _mm256_or_si256(red, _mm256_slli_epi16(_mm256_sub_epi16(matches, red), SCORE_WHITE_SHIFT));
+        /* packus works per 128 bit lane, so pack the two halves by hand */
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+        _mm_storeu_si128((__m128i *) (scores + i), packed);
+    }
+#undef EQUAL_SLOTS_AVX2
+    /* the callers are compiled without AVX, avoid the AVX to SSE transition penalty */
+    _mm256_zeroupper();
+    score_codes_scalar(guess, codes + i, n - i, scores + i);
+}
+#endif
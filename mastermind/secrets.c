@@ -0,0 +1,36 @@
+/**
+ * @file secrets.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief secrets of the games started by the server
+ *
+ * @date 17.10.2015
+ *
+ */
+
+#include "secrets.h"
+
+/* === Implementations === */
+
+void secret_fixed(struct secret_source *source, code_t secret)
+{
+    source->kind = SECRET_FIXED;
+    source->fixed = secret;
+}
+
+void secret_random(struct secret_source *source, uint64_t seed, int stream)
+{
+    source->kind = SECRET_RANDOM;
+    /* streams start at unrelated points of the generator's sequence */
+    source->state = secret_mix(seed ^ secret_mix((uint64_t) stream + 1));
+}
+
+void secret_iterate(struct secret_source *source, const struct codelist *list,
+                    size_t first, size_t step)
+{
+    source->kind = SECRET_LIST;
+    source->list = list;
+    source->next = first % list->count;
+    source->step = step % list->count;
+}
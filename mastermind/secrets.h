@@ -0,0 +1,127 @@
+/**
+ * @file secrets.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief secrets of the games started by the server
+ *
+ * @details
+ *    a secret source hands out the secret of every new game. It is either
+ *    the fixed secret of the command line, drawn from a splitmix64
+ *    generator or taken in turn from a mapped code list (see codelist.h).
+ *    Every thread owns its own source, so drawing a secret takes no locks:
+ *    worker i draws from its own random stream or takes every step-th code
+ *    of the list starting at code i
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef SECRETS_H
+#define SECRETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mastermind.h"
+#include "codelist.h"
+
+/* === Type Definitions === */
+
+/** where the secrets of a source come from */
+enum secret_kind {
+    SECRET_FIXED,
+    SECRET_RANDOM,
+    SECRET_LIST
+};
+
+/** the secrets of one thread */
+struct secret_source {
+    enum secret_kind kind;
+    code_t fixed;
+    /* generator state */
+    uint64_t state;
+    /* list, index of the next code and distance to the one after it */
+    const struct codelist *list;
+    size_t next;
+    size_t step;
+};
+
+/* === Prototypes === */
+
+/**
+ * secret_fixed
+ * @brief Let a source hand out the same secret for every game
+ * @param source The source
+ * @param secret The encoded secret
+ */
+void secret_fixed(struct secret_source *source, code_t secret);
+
+/**
+ * secret_random
+ * @brief Let a source draw uniformly distributed secrets
+ * @param source The source
+ * @param seed Seed shared by all streams
+ * @param stream Number of the stream, every stream of a seed draws
+ * different secrets
+ */
+void secret_random(struct secret_source *source, uint64_t seed, int stream);
+
+/**
+ * secret_iterate
+ * @brief Let a source take the secrets of a list in turn, wrapping around
+ * at its end
+ * @param source The source
+ * @param list The list, has to stay mapped while the source is used
+ * @param first Index of the first secret
+ * @param step Distance between two secrets
+ */
+void secret_iterate(struct secret_source *source, const struct codelist *list,
+                    size_t first, size_t step);
+
+/**
+ * secret_mix
+ * @brief splitmix64 output function
+ * @param z The value to mix
+ * @return The mixed value
+ */
+static inline uint64_t secret_mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * secret_next
+ * @brief Secret of the next game
+ * @param source The source
+ * @return The encoded secret
+ */
+static inline code_t secret_next(struct secret_source *source)
+{
+    uint64_t r;
+    code_t secret;
+
+    switch (source->kind) {
+    case SECRET_RANDOM:
+        r = secret_mix(source->state += 0x9e3779b97f4a7c15ULL);
+#if COLORS == 1 << SHIFT_WIDTH
+        /* every packed code is valid */
+        return r & CODE_MASK;
+#else
+        /* scale the upper 32 bits to an index of a valid code */
+        return code_from_index(((r >> 32) * VALID_CODES) >> 32);
+#endif
+    case SECRET_LIST:
+        secret = source->list->codes[source->next];
+        source->next += source->step;
+        if (source->next >= source->list->count) {
+            source->next %= source->list->count;
+        }
+        return secret;
+    default:
+        return source->fixed;
+    }
+}
+
+#endif /* SECRETS_H */
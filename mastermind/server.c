@@ -10,6 +10,37 @@
  *    listen for client guesses on a socket
  *    returns the number of red and white pins for each received guess
  *    returns a game over message after 35 guesses and shuts down  
+ *    with -e the server keeps running and plays any number of concurrent
+ *    games over the listening socket, driven by an epoll event loop
+ *    with -t the games are spread over several worker threads, each with
+ *    its own SO_REUSEPORT listener and event loop
+ *    with -u the event loops hand their receives and sends to io_uring:
+ *    the requests of all connections are queued and submitted together
+ *    with the wait for the next completions in a single system call. The
+ *    epoll loop is used if the kernel does not support io_uring
+ *    clients may switch to the framed protocol (see mastermind.h) to send
+ *    several guesses per request or to play many games over one connection
+ *    a framed client that started a game with FRAME_NEW keeps its connection
+ *    when the game is over and may start the next one on it. Nagle's
+ *    algorithm is off for all connections, the one or two byte messages
+ *    would otherwise wait for the delayed ack of the previous one
+ *    in event mode every loop records read/compute/write latencies (with
+ *    -u only compute, reads and writes run in the kernel) and the rounds
+ *    needed to win in its own counters, they are merged and printed on
+ *    SIGUSR1, every <seconds> with -i and on shutdown
+ *    instead of the <secret-sequence> every game may get a fresh secret,
+ *    drawn at random with -r <seed> or taken in turn from a code list file
+ *    with -s <file> (see secrets.h, codelist.h)
+ *    with -m clients on the same host may play over a shared memory region
+ *    instead of a socket (see shmring.h). One more thread serves all of its
+ *    channels, spinning while requests come in and sleeping on a futex
+ *    when they stop, and counts its games and latencies like a worker
+ *    with -g <file> framed clients may start their games with FRAME_SAVE,
+ *    the server keeps them in a memory mapped game table (see gametable.h)
+ *    and a client whose connection dropped resumes its game on a new one
+ *    with FRAME_RESUME, also after a restart of the server. A suspended
+ *    game is not counted as aborted; without -e the server accepts the
+ *    next connection instead of exiting while its saved game is running
  *
  *  @date 17.10.2015
  *
@@ -40,31 +71,60 @@
 #include <stdarg.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <poll.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <errno.h>
 #include <limits.h>
-
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "mastermind.h"
+#include "score.h"
+#include "game.h"
+#include "histogram.h"
+#include "uring.h"
+#include "secrets.h"
+#include "shmring.h"
+#include "gametable.h"
 
 /* === Constants === */
 
-#define MAX_TRIES (35)
-#define SLOTS (5)
-#define COLORS (8)
+/* largest request and response frame */
+#define FRAME_IN_BYTES (FRAME_HEADER_BYTES + FRAME_MAX_COUNT * SESSION_REQ_BYTES)
+#define FRAME_OUT_BYTES (FRAME_HEADER_BYTES + FRAME_MAX_COUNT * SESSION_RESP_BYTES)
 
-#define READ_BYTES (2)
-#define WRITE_BYTES (1)
-#define BUFFER_BYTES (2)
-#define SHIFT_WIDTH (3)
-#define PARITY_ERR_BIT (6)
-#define GAME_LOST_ERR_BIT (7)
+/* initial size of a connection's session table */
+#define SESSION_MIN_GAMES (64)
 
-#define EXIT_PARITY_ERROR (2)
-#define EXIT_GAME_LOST (3)
-#define EXIT_MULTIPLE_ERRORS (4)
+/* number of game ids */
+#define SESSION_MAX_GAMES (UINT16_MAX + 1)
 
+/* default listen backlog in single game mode */
 #define BACKLOG (5)
 
+/* maximum number of worker threads */
+#define MAX_WORKERS (256)
+
+/* maximum number of epoll events handled per wakeup */
+#define MAX_EVENTS (256)
+
+/* conn_need() result for a malformed request */
+#define PROTOCOL_ERROR (0)
+
+/* size of an io_uring submission queue */
+#define URING_ENTRIES (4096)
+
+/* user_data of io_uring completions without a connection, the others
+   carry the (aligned) address of their connection */
+#define URING_ACCEPT (1)
+#define URING_WAKE (2)
+
 /* === Macros === */
 
 #ifdef ENDEBUG
@@ -87,15 +147,143 @@ static int sockfd = -1;
 /* File descriptor for connection socket */
 static int connfd = -1;
 
+/* Listening sockets of the worker threads */
+static int worker_fds[MAX_WORKERS];
+static int worker_count = 0;
+
+/* Secrets of -s, shared read-only by all threads */
+static struct codelist secret_list;
+
+/* Shared memory region of -m */
+static struct shm_region *shm = NULL;
+static long int shm_port;
+
+/* Game table of -g, shared by all threads */
+static struct gametable game_table;
+
+/* Pipe used to wake up the worker threads on shutdown */
+static int wakefd[2] = {-1, -1};
+
 /* This variable is set upon receipt of a signal */
 volatile sig_atomic_t quit = 0;
 
+/* Set by SIGUSR1 and the -i timer to print the statistics */
+volatile sig_atomic_t dump = 0;
+
 
 /* === Type Definitions === */
 
 struct opts {
     long int portno;
-    uint8_t secret[SLOTS];
+    /* where the secrets come from, encoded secret for SECRET_FIXED */
+    enum secret_kind secrets;
+    code_t secret;
+    uint64_t seed;
+    const char *secret_file;
+    int event_mode;
+    /* number of worker threads (event mode) */
+    long int workers;
+    /* listen backlog, -1 for the mode's default */
+    long int backlog;
+    /* seconds between statistics dumps, 0 for none */
+    long int interval;
+    /* serve with io_uring (event mode) */
+    int uring;
+    /* serve clients on this host over shared memory (event mode) */
+    int shm;
+    /* game table file of the resumable games, NULL for none */
+    const char *table_file;
+};
+
+/* State of a single game */
+struct game {
+    int round;
+    /* encoded secret */
+    code_t secret;
+};
+
+/* Compact state of a game played in a session, indexed by game id */
+struct session_game {
+    /* encoded secret */
+    code_t secret;
+    /* current round, 0 if the game id is free */
+    uint8_t round;
+};
+
+/* A client connection and its game */
+struct conn {
+    int fd;
+    /* secrets of the connection's games */
+    struct secret_source *secrets;
+    /* 0 for the legacy protocol, else the framed protocol version */
+    int proto;
+    struct game game;
+    /* games of the session, grows up to SESSION_MAX_GAMES entries */
+    struct session_game *session;
+    size_t session_size;
+    unsigned long session_active;
+    /* partially received request, points to small_in or a frame buffer */
+    uint8_t *inbuf;
+    size_t inlen;
+    /* response not yet (fully) sent, points to small_out or a frame buffer */
+    uint8_t *outbuf;
+    size_t outoff;
+    size_t outlen;
+    uint8_t small_in[GUESS_BYTES];
+    uint8_t small_out[ANSWER_BYTES];
+    /* waiting for EPOLLOUT instead of EPOLLIN, with io_uring a send
+       is pending while outlen != 0 and a receive otherwise */
+    int waiting;
+    /* game is over, close the connection once outbuf is flushed */
+    int over;
+    /* started a game with FRAME_NEW, stays open between games */
+    int keepalive;
+    /* entry of the game in the game table, NULL if it is not saved */
+    struct saved_game *saved;
+    uint32_t lease;
+    struct conn *prev;
+    struct conn *next;
+};
+
+/* Outcome counters of finished games */
+struct game_totals {
+    unsigned long won;
+    unsigned long lost;
+    unsigned long parity_errors;
+    unsigned long aborted;
+    /* won games by the round of the winning guess */
+    unsigned long rounds[MAX_TRIES + 1];
+};
+
+/* Latencies of the requests of an event loop in ns */
+struct loop_stats {
+    /* recv() calls that received data */
+    struct histogram read;
+    /* process_request() */
+    struct histogram compute;
+    /* first attempt to send the response */
+    struct histogram write;
+};
+
+/* An epoll loop serving all games accepted on one listening socket */
+struct event_loop {
+    int epfd;
+    int listenfd;
+    struct secret_source secrets;
+    struct conn *conns;
+    /* only written by the loop's own thread, read unlocked by dumps */
+    struct game_totals totals;
+    struct loop_stats stats;
+    /* loop runs in the main thread and prints the dumps itself */
+    int report;
+    /* use io_uring instead of epoll */
+    int uring;
+    /* an accept is pending (io_uring) or the listener is polled (epoll), not
+       rearmed while out of descriptors */
+    int accepting;
+    /* serves the channels of the shared memory region instead of a listener */
+    struct shm_region *shm;
+    pthread_t thread;
 };
 
 
@@ -137,14 +325,356 @@ static int write_to_client(int sockfd_con, uint8_t *buffer, size_t n);
 static uint8_t *read_from_client(int sockfd_con, uint8_t *buffer, size_t n);
 
 /**
- * compute_answer
- * @brief Compute answer to request
- * @param req Client's guess
- * @param resp Buffer that will be sent to the client
- * @param secret The server's secret
- * @return Number of correct matches on success; -1 in case of a parity error
+ * answer_guesses
+ * @brief Play a sequence of guesses against a game
+ * @param game The game
+ * @param guesses Encoded guesses, GUESS_BYTES each
+ * @param count Number of guesses
+ * @param answers Buffer for one answer byte per played guess
+ * @param status Set to the game_status() of the last played guess
+ * @return Number of guesses played, less than count if the game ended early
+ */
+static int answer_guesses(struct game *game, const uint8_t *guesses, int count,
+                          uint8_t *answers, int *status);
+
+/**
+ * count_outcome
+ * @brief Add the outcome of a finished game to the totals
+ * @param totals Counters to update
+ * @param status game_status() of the finished game
+ * @param round Round of the last guess of the game
+ */
+static void count_outcome(struct game_totals *totals, int status, int round);
+
+/**
+ * conn_init
+ * @brief Initialize a connection with a new game
+ * @param conn The connection
+ * @param fd Connection socket
+ * @param secrets Source of the secrets of the connection's games
+ */
+static void conn_init(struct conn *conn, int fd, struct secret_source *secrets);
+
+/**
+ * conn_abandons
+ * @brief Test if closing a connection gives up a game that was started
+ * @param conn The connection
+ * @return 1 if the game counts as aborted, 0 if none was played or it is
+ * saved and may be resumed
+ */
+static int conn_abandons(const struct conn *conn);
+
+/**
+ * conn_resume
+ * @brief Make a saved game the connection's game and list its rounds in
+ * a FRAME_RESUME response
+ * @param conn The connection
+ * @param token Token of the game
+ * @param out The entries of the response
+ * @return Number of entries
+ */
+static int conn_resume(struct conn *conn, uint64_t token, uint8_t *out);
+
+/**
+ * conn_need
+ * @brief Number of bytes the connection's current request consists of,
+ * as far as it can be told from the bytes received so far
+ * @param conn The connection
+ * @return Request size, PROTOCOL_ERROR for a malformed frame header
+ */
+static size_t conn_need(struct conn *conn);
+
+/**
+ * process_request
+ * @brief Play a complete request in conn->inbuf and put the response in
+ * conn->outbuf
+ * @param conn The connection
+ * @param totals Counters for session games and the games of a kept alive
+ * connection finished by the request
+ * @return game_status() of the connection's game after the request,
+ * GAME_RUNNING for session frames and the switch to the framed protocol
+ */
+static int process_request(struct conn *conn, struct game_totals *totals);
+
+/**
+ * session_open
+ * @brief Open a game in the connection's session
+ * @param conn The connection
+ * @param id Game id
+ * @param secret Encoded secret or SECRET_SERVER for the next secret of
+ * the connection's source
+ * @return OPEN_OK or OPEN_IN_USE
+ */
+static uint8_t session_open(struct conn *conn, uint16_t id, code_t secret);
+
+/**
+ * session_play
+ * @brief Play a guess against a game of the connection's session
+ * @param conn The connection
+ * @param id Game id
+ * @param guess The encoded guess
+ * @param totals Counters updated if the game ends
+ * @return The answer, ANSWER_NO_GAME if no game with this id is open
+ */
+static uint8_t session_play(struct conn *conn, uint16_t id, const uint8_t *guess,
+                            struct game_totals *totals);
+
+/**
+ * session_play_frame
+ * @brief Play the guesses of a FRAME_PLAY request, decoded and scored as
+ * one batch
+ * @param conn The connection
+ * @param entries The entries of the request
+ * @param count Number of entries
+ * @param out The entries of the response
+ * @param totals Counters updated for the games that end
+ */
+static void session_play_frame(struct conn *conn, const uint8_t *entries, int count,
+                               uint8_t *out, struct game_totals *totals);
+
+/**
+ * conn_free
+ * @brief Free the frame buffers and session table of a connection
+ * @param conn The connection
+ */
+static void conn_free(struct conn *conn);
+
+/**
+ * secrets_init
+ * @brief Set up the secret source of a thread as selected by the options
+ * @param source The source
+ * @param options Parsed command line options
+ * @param index Number of the thread
+ * @param count Number of threads
+ */
+static void secrets_init(struct secret_source *source, struct opts *options,
+                         int index, int count);
+
+/**
+ * parse_number
+ * @brief Parse a decimal command line argument
+ * @param arg The argument
+ * @param name Name of the argument used in error messages
+ * @param min Smallest allowed value
+ * @param max Largest allowed value
+ * @return The parsed number, terminates the program on error
+ */
+static long int parse_number(const char *arg, const char *name, long int min, long int max);
+
+/**
+ * usage
+ * @brief Print usage and terminate the program
+ */
+static void usage(void);
+
+/**
+ * open_listener
+ * @brief Create a TCP/IP socket listening on portno
+ * @param portno Port to bind to
+ * @param backlog Length of the queue of pending connections
+ * @param reuseport Set SO_REUSEPORT so several sockets can share the port
+ * @return The listening socket, terminates the program on error
+ */
+static int open_listener(long int portno, int backlog, int reuseport);
+
+/**
+ * serve_single
+ * @brief Accept one client on sockfd and play a single game
+ * @param options Parsed command line options
+ * @return Exit code of the game (see main)
+ */
+static int serve_single(struct opts *options);
+
+/**
+ * serve_reaccept
+ * @brief Accept the next connection on sockfd in place of one that dropped
+ * while its saved game was running, so the client can resume it
+ * @param conn The connection, set up for the next one
+ * @param secrets Source of the secrets of the connection's games
+ * @return 1 if the next connection was accepted or a signal was caught
+ * while waiting for it, 0 if the dropped connection had no game to resume
+ */
+static int serve_reaccept(struct conn *conn, struct secret_source *secrets);
+
+/**
+ * serve_events
+ * @brief Play games with all clients connecting to loop->listenfd until
+ * a signal is caught
+ * @param loop Event loop with listenfd and secrets initialized
+ */
+static void serve_events(struct event_loop *loop);
+
+/**
+ * serve_uring
+ * @brief Like serve_events, with io_uring instead of epoll
+ * @param loop Event loop with listenfd and secrets initialized
+ * @param ring Set up io_uring instance
+ */
+static void serve_uring(struct event_loop *loop, struct uring *ring);
+
+/**
+ * serve_workers
+ * @brief Run one event loop per worker thread until a signal is caught,
+ * then report the throughput of every worker
+ * @param options Parsed command line options
+ */
+static void serve_workers(struct opts *options);
+
+/**
+ * serve_shm
+ * @brief Play the games of the shared memory channels until shutdown
+ * @param loop The loop, its games and latencies are counted as a worker's
+ */
+static void serve_shm(struct event_loop *loop);
+
+/**
+ * shm_serve_channels
+ * @brief Answer the pending requests of all channels once
+ * @param loop The loop
+ * @param games Games of the channels
+ * @param owners Owner values of the channels the games belong to
+ * @param polling Set to 1 if a client playing a game busy-polls
+ * @return Number of requests answered
+ */
+static int shm_serve_channels(struct event_loop *loop, struct game *games,
+                              uint32_t *owners, int *polling);
+
+/**
+ * shm_pending
+ * @brief Test if a channel has a request, the last look before sleeping
+ * @param arg The region
+ * @return 1 if there is a request, else 0
+ */
+static int shm_pending(void *arg);
+
+/**
+ * worker_main
+ * @brief Start routine of a worker thread
+ * @param arg The worker's event loop
+ * @return NULL
+ */
+static void *worker_main(void *arg);
+
+/**
+ * print_stats
+ * @brief Merge the counters of several event loops and print them
+ * @param loops The event loops
+ * @param count Number of event loops
+ */
+static void print_stats(struct event_loop *loops, int count);
+
+/**
+ * print_latency
+ * @brief Print the percentiles of a latency histogram
+ * @param name Name of the latency
+ * @param histogram Latencies in ns
+ */
+static void print_latency(const char *name, const struct histogram *histogram);
+
+/**
+ * now_ns
+ * @brief Monotonic time
+ * @return The time in ns
+ */
+static uint64_t now_ns(void);
+
+/**
+ * accept_conns
+ * @brief Accept all pending connections and start a game for each of them
+ * @param loop The event loop
+ */
+static void accept_conns(struct event_loop *loop);
+
+/**
+ * handle_conn
+ * @brief Handle readiness events of a connection
+ * @param loop The event loop
+ * @param conn The connection
+ * @param events Events reported by epoll_wait
+ */
+static void handle_conn(struct event_loop *loop, struct conn *conn, uint32_t events);
+
+/**
+ * conn_received
+ * @brief Process the bytes received on a connection, put the response in
+ * conn->outbuf once the request is complete
+ * @param loop The event loop
+ * @param conn The connection
+ * @param clock Time the bytes were received, set to the time the response
+ * is ready
+ * @return 1 if a response is ready, 0 if more bytes are needed and -1 if
+ * the connection was closed for a malformed frame
+ */
+static int conn_received(struct event_loop *loop, struct conn *conn, uint64_t *clock);
+
+/**
+ * uring_queue
+ * @brief Queue a submission entry, terminates the program on error
+ * @param ring The io_uring instance
+ * @param opcode Operation
+ * @param fd File descriptor
+ * @param addr Buffer or other operation specific address
+ * @param len Length of the buffer
+ * @param data user_data of the completion
+ * @return The entry for further settings
+ */
+static struct io_uring_sqe *uring_queue(struct uring *ring, int opcode, int fd,
+                                        void *addr, unsigned len, uint64_t data);
+
+/**
+ * uring_transfer
+ * @brief Queue the next receive or the pending send of a connection
+ * @param ring The io_uring instance
+ * @param conn The connection
+ */
+static void uring_transfer(struct uring *ring, struct conn *conn);
+
+/**
+ * uring_accepted
+ * @brief Start a game for a connection accepted by io_uring and rearm the
+ * accept
+ * @param loop The event loop
+ * @param ring The io_uring instance
+ * @param fd Result of the accept
+ */
+static void uring_accepted(struct event_loop *loop, struct uring *ring, int fd);
+
+/**
+ * uring_completed
+ * @brief Handle the completion of a connection's receive or send
+ * @param loop The event loop
+ * @param ring The io_uring instance
+ * @param conn The connection
+ * @param res Result of the operation
+ */
+static void uring_completed(struct event_loop *loop, struct uring *ring,
+                            struct conn *conn, int res);
+
+/**
+ * flush_conn
+ * @brief Send the pending response of a connection, waiting for EPOLLOUT
+ * if the socket buffer is full
+ * @param loop The event loop
+ * @param conn The connection
+ * @return 0 when everything was sent, 1 if data is still pending and -1 on error
+ */
+static int flush_conn(struct event_loop *loop, struct conn *conn);
+
+/**
+ * close_conn
+ * @brief Close a connection and free it
+ * @param loop The event loop
+ * @param conn The connection
+ */
+static void close_conn(struct event_loop *loop, struct conn *conn);
+
+/**
+ * listener_poll
+ * @brief Set the events polled on the listening socket of an epoll loop
+ * @param loop Event loop
+ * @param events EPOLLIN to accept connections, 0 to stop accepting
  */
-static int compute_answer(uint16_t req, uint8_t *resp, uint8_t *secret);
+static void listener_poll(struct event_loop *loop, uint32_t events);
 
 /**
  * bail_out
@@ -207,308 +737,1555 @@ static uint8_t *read_from_client(int fd, uint8_t *buffer, size_t n)
     return buffer;
 }
 
-static int compute_answer(uint16_t req, uint8_t *resp, uint8_t *secret)
+static int answer_guesses(struct game *game, const uint8_t *guesses, int count,
+                          uint8_t *answers, int *status)
 {
-    int colors_left[COLORS];
-    int guess[COLORS];
-    uint8_t parity_calc, parity_recv;
-    int red, white;
-    int j;   
-
-    parity_recv = (req >> 15) & 1;
-
-    /* extract the guess and calculate parity */
-    parity_calc = 0;
-    for (j = 0; j < SLOTS; ++j) {
-        int tmp = req & 0x7;
-        parity_calc ^= tmp ^ (tmp >> 1) ^ (tmp >> 2);
-        guess[j] = tmp;
-        req >>= SHIFT_WIDTH;
-    }
-    parity_calc &= 0x1;
+    code_t codes[FRAME_MAX_COUNT];
+    uint8_t errors[FRAME_MAX_COUNT];
 
-    /* marking red and white */
-    (void) memset(&colors_left[0], 0, sizeof(colors_left));
-    red = white = 0;
-    for (j = 0; j < SLOTS; ++j) {
-        /* mark red */
-        if (guess[j] == secret[j]) {
-            red++;
-        } else {
-            colors_left[secret[j]]++;
-        }
+    /* the game is over after MAX_TRIES rounds at the latest */
+    if (count > MAX_TRIES - game->round + 1) {
+        count = MAX_TRIES - game->round + 1;
     }
-    for (j = 0; j < SLOTS; ++j) {
-        /* not marked red */
-        if (guess[j] != secret[j]) {
-            if (colors_left[guess[j]] > 0) {
-                white++;
-                colors_left[guess[j]]--;
-            }
+    game_decode(guesses, GUESS_BYTES, count, codes, errors);
+    game_rounds(game->secret, game->round, codes, errors, count, answers);
+
+    *status = GAME_RUNNING;
+    for (int i = 0; i < count; i++) {
+        DEBUG("Round %d: Received 0x%lx\n", game->round, (unsigned long) codes[i]);
+        *status = game_answer_status(answers[i]);
+        if (*status != GAME_RUNNING) {
+            return i + 1;
         }
+        game->round++;
     }
+    return count;
+}
 
-    /* build response buffer */
-    resp[0] = red;
-    resp[0] |= (white << SHIFT_WIDTH);
-    if (parity_recv != parity_calc) {
-        resp[0] |= (1 << PARITY_ERR_BIT);
-        return -1;
-    } else {
-        return red;
+static void count_outcome(struct game_totals *totals, int status, int round)
+{
+    switch (status) {
+    case EXIT_SUCCESS:
+        totals->won++;
+        totals->rounds[round]++;
+        break;
+    case EXIT_GAME_LOST:
+        totals->lost++;
+        break;
+    case EXIT_MULTIPLE_ERRORS:
+        totals->lost++;
+        totals->parity_errors++;
+        break;
+    case EXIT_PARITY_ERROR:
+        totals->parity_errors++;
+        break;
+    default:
+        totals->aborted++;
+        break;
     }
 }
 
-static void bail_out(int exitcode, const char *fmt, ...)
+static void conn_init(struct conn *conn, int fd, struct secret_source *secrets)
 {
-    va_list ap;
+    memset(conn, 0, sizeof *conn);
+    conn->fd = fd;
+    conn->secrets = secrets;
+    conn->game.round = 1;
+    conn->game.secret = secret_next(secrets);
+    conn->inbuf = conn->small_in;
+    conn->outbuf = conn->small_out;
+}
 
-    (void) fprintf(stderr, "%s: ", progname);
-    if (fmt != NULL) {
-        va_start(ap, fmt);
-        (void) vfprintf(stderr, fmt, ap);
-        va_end(ap);
-    }
-    if (errno != 0) {
-        (void) fprintf(stderr, ": %s", strerror(errno));
+static int conn_abandons(const struct conn *conn)
+{
+    if (conn->saved != NULL) {
+        return 0;
     }
-    (void) fprintf(stderr, "\n");
+    return conn->proto == 0 || conn->game.round > 1;
+}
 
-    free_resources();
-    exit(exitcode);
+static int conn_resume(struct conn *conn, uint64_t token, uint8_t *out)
+{
+    struct saved_game *saved = NULL;
+    struct saved_game game;
+    int played;
+
+    conn->saved = NULL;
+    conn->game.round = 0;
+    if (game_table.header != NULL) {
+        saved = gametable_resume(&game_table, token, &conn->lease, &game);
+    }
+    put_code(out, 0);
+    if (saved == NULL) {
+        out[GUESS_BYTES] = RESUME_UNKNOWN;
+        return 1;
+    }
+    conn->saved = saved;
+    conn->game.secret = game.secret;
+    played = game.played < MAX_TRIES ? game.played : MAX_TRIES;
+    out[GUESS_BYTES] = game.over ? RESUME_OVER : RESUME_RUNNING;
+    /* the answers are played again, the table only keeps the guesses */
+    for (int i = 0; i < played; i++) {
+        out += RESUME_ENTRY_BYTES;
+        put_code(out, game.guesses[i]);
+        (void) play_round(i + 1, game.guesses[i], out + GUESS_BYTES, game.secret);
+    }
+    conn->game.round = game.over ? 0 : played + 1;
+    DEBUG("fd %d: resumed game %llx in round %d\n", conn->fd,
+          (unsigned long long) token, conn->game.round);
+    return played + 1;
 }
 
-static void free_resources(void)
+static size_t conn_need(struct conn *conn)
 {
-    /* clean up resources */
-    DEBUG("Shutting down server\n");
-    if(connfd >= 0) {
-        (void) close(connfd);
+    uint16_t count;
+
+    if (conn->proto == 0) {
+        return GUESS_BYTES;
     }
-    if(sockfd >= 0) {
-        (void) close(sockfd);
+    if (conn->inlen < FRAME_HEADER_BYTES) {
+        return FRAME_HEADER_BYTES;
+    }
+    count = frame_count(conn->inbuf);
+    if (count == 0 || count > FRAME_MAX_COUNT) {
+        return PROTOCOL_ERROR;
+    }
+    switch (conn->inbuf[0]) {
+    case FRAME_GUESSES:
+        return FRAME_HEADER_BYTES + count * GUESS_BYTES;
+    case FRAME_OPEN:
+    case FRAME_PLAY:
+        return FRAME_HEADER_BYTES + count * SESSION_REQ_BYTES;
+    case FRAME_NEW:
+    case FRAME_SAVE:
+        return count == 1 ? FRAME_HEADER_BYTES + GUESS_BYTES : PROTOCOL_ERROR;
+    case FRAME_RESUME:
+        return count == 1 ? FRAME_HEADER_BYTES + RESUME_TOKEN_BYTES : PROTOCOL_ERROR;
+    default:
+        return PROTOCOL_ERROR;
     }
 }
 
-static void signal_handler(int sig)
+static int process_request(struct conn *conn, struct game_totals *totals)
 {
-    quit = 1;
+    const uint8_t *entry = conn->inbuf + FRAME_HEADER_BYTES;
+    uint8_t *out = conn->outbuf + FRAME_HEADER_BYTES;
+    uint16_t count;
+    code_t secret;
+    uint64_t token;
+    int status;
+
+    if (conn->proto == 0) {
+        if (conn->game.round == 1 && get_code(conn->inbuf) == PROTO_HELLO) {
+            /* switch to the framed protocol */
+            uint8_t *framed_in = malloc(FRAME_IN_BYTES);
+            uint8_t *framed_out = malloc(FRAME_OUT_BYTES);
+            if (framed_in == NULL || framed_out == NULL) {
+                free(framed_in);
+                free(framed_out);
+                bail_out(EXIT_FAILURE, "malloc");
+            }
+            DEBUG("fd %d: framed protocol version %d\n", conn->fd, PROTO_VERSION);
+            conn->proto = PROTO_VERSION;
+            conn->inbuf = framed_in;
+            conn->outbuf = framed_out;
+            conn->outbuf[0] = PROTO_VERSION;
+            conn->outlen = ANSWER_BYTES;
+            return GAME_RUNNING;
+        }
+        (void) answer_guesses(&conn->game, conn->inbuf, 1, conn->outbuf, &status);
+        conn->outlen = ANSWER_BYTES;
+        return status;
+    }
+
+    count = frame_count(conn->inbuf);
+    switch (conn->inbuf[0]) {
+    case FRAME_OPEN:
+        for (int i = 0; i < count; i++) {
+            uint16_t id = get16(entry);
+            put16(out, id);
+            out[2] = session_open(conn, id, get_code(entry + 2));
+            entry += SESSION_REQ_BYTES;
+            out += SESSION_RESP_BYTES;
+        }
+        frame_header(conn->outbuf, FRAME_OPEN, count);
+        conn->outlen = FRAME_HEADER_BYTES + count * SESSION_RESP_BYTES;
+        return GAME_RUNNING;
+    case FRAME_PLAY:
+        session_play_frame(conn, entry, count, out, totals);
+        frame_header(conn->outbuf, FRAME_PLAY, count);
+        conn->outlen = FRAME_HEADER_BYTES + count * SESSION_RESP_BYTES;
+        return GAME_RUNNING;
+    case FRAME_NEW:
+    case FRAME_SAVE:
+        /* a game that was played is given up */
+        if (conn_abandons(conn)) {
+            totals->aborted++;
+        }
+        secret = get_code(entry);
+        if (secret & SECRET_SERVER) {
+            secret = secret_next(conn->secrets);
+        }
+        conn->game.secret = secret;
+        conn->game.round = 1;
+        conn->keepalive = 1;
+        conn->saved = NULL;
+        out[0] = OPEN_OK;
+        if (conn->inbuf[0] == FRAME_NEW) {
+            frame_header(conn->outbuf, FRAME_NEW, 1);
+            conn->outlen = FRAME_HEADER_BYTES + ANSWER_BYTES;
+            return GAME_RUNNING;
+        }
+        if (game_table.header != NULL) {
+            conn->saved = gametable_save(&game_table, secret, &conn->lease, &token);
+            put64(out + ANSWER_BYTES, token);
+        } else {
+            out[0] = OPEN_NO_SAVE;
+            put64(out + ANSWER_BYTES, 0);
+        }
+        frame_header(conn->outbuf, FRAME_SAVE, 1);
+        conn->outlen = FRAME_HEADER_BYTES + SAVE_RESP_BYTES;
+        return GAME_RUNNING;
+    case FRAME_RESUME:
+        if (conn_abandons(conn)) {
+            totals->aborted++;
+        }
+        conn->keepalive = 1;
+        count = conn_resume(conn, get64(entry), out);
+        frame_header(conn->outbuf, FRAME_RESUME, count);
+        conn->outlen = FRAME_HEADER_BYTES + count * RESUME_ENTRY_BYTES;
+        return GAME_RUNNING;
+    default:
+        if (conn->saved != NULL && !gametable_owns(conn->saved, conn->lease)) {
+            /* the game was resumed on another connection */
+            conn->saved = NULL;
+            conn->game.round = 0;
+        }
+        if (conn->game.round == 0) {
+            /* the game of a kept alive connection is over */
+            memset(out, ANSWER_NO_GAME, count);
+            frame_header(conn->outbuf, FRAME_GUESSES, count);
+            conn->outlen = FRAME_HEADER_BYTES + count * ANSWER_BYTES;
+            return GAME_RUNNING;
+        }
+        count = answer_guesses(&conn->game, entry, count, out, &status);
+        if (conn->saved != NULL) {
+            gametable_record(conn->saved, conn->lease, entry, count, status != GAME_RUNNING);
+        }
+        frame_header(conn->outbuf, FRAME_GUESSES, count);
+        conn->outlen = FRAME_HEADER_BYTES + count * ANSWER_BYTES;
+        if (status != GAME_RUNNING && conn->keepalive) {
+            /* keep the connection, wait for the next FRAME_NEW */
+            count_outcome(totals, status, conn->game.round);
+            conn->game.round = 0;
+            return GAME_RUNNING;
+        }
+        return status;
+    }
 }
 
-/**
- * main
- * @brief Program entry point
- * @param argc The argument counter
- * @param argv The argument vector
- * @return EXIT_SUCCESS on success, EXIT_PARITY_ERROR in case of an parity
- * error, EXIT_GAME_LOST in case client needed to many guesses,
- * EXIT_MULTIPLE_ERRORS in case multiple errors occured in one round,
- * EXIT_FAILURE if socket creation failed
- */
-int main(int argc, char *argv[])
+static uint8_t session_open(struct conn *conn, uint16_t id, code_t secret)
 {
+    struct session_game *g;
 
-    struct opts options;
-    int round;
-    int ret;
+    /* grow the table to the next power of two covering id */
+    if (id >= conn->session_size) {
+        size_t size = conn->session_size ? conn->session_size : SESSION_MIN_GAMES;
+        while (size <= id) {
+            size *= 2;
+        }
+        g = realloc(conn->session, size * sizeof *g);
+        if (g == NULL) {
+            bail_out(EXIT_FAILURE, "realloc");
+        }
+        memset(g + conn->session_size, 0, (size - conn->session_size) * sizeof *g);
+        conn->session = g;
+        conn->session_size = size;
+    }
 
-    parse_args(argc, argv, &options);
+    g = &conn->session[id];
+    if (g->round != 0) {
+        return OPEN_IN_USE;
+    }
+    if (secret & SECRET_SERVER) {
+        secret = secret_next(conn->secrets);
+    }
+    g->secret = secret;
+    g->round = 1;
+    conn->session_active++;
+    return OPEN_OK;
+}
 
-    /* setup signal handlers */
-    const int signals[] = {SIGINT, SIGTERM};
-    struct sigaction s;
+static uint8_t session_play(struct conn *conn, uint16_t id, const uint8_t *guess,
+                            struct game_totals *totals)
+{
+    struct session_game *g;
+    struct game game;
+    uint8_t answer;
+    int status;
 
-    s.sa_handler = signal_handler;
-    s.sa_flags   = 0;
-    if(sigfillset(&s.sa_mask) < 0) {
-        bail_out(EXIT_FAILURE, "sigfillset");
+    if (id >= conn->session_size || conn->session[id].round == 0) {
+        return ANSWER_NO_GAME;
     }
-    for(int i = 0; i < COUNT_OF(signals); i++) {
-        if (sigaction(signals[i], &s, NULL) < 0) {
-            bail_out(EXIT_FAILURE, "sigaction");
+    g = &conn->session[id];
+    game.round = g->round;
+    game.secret = g->secret;
+
+    (void) answer_guesses(&game, guess, 1, &answer, &status);
+    if (status != GAME_RUNNING) {
+        count_outcome(totals, status, game.round);
+        g->round = 0;
+        conn->session_active--;
+    } else {
+        g->round = game.round;
+    }
+    return answer;
+}
+
+static void session_play_frame(struct conn *conn, const uint8_t *entries, int count,
+                               uint8_t *out, struct game_totals *totals)
+{
+    code_t codes[FRAME_MAX_COUNT];
+    code_t secrets[FRAME_MAX_COUNT];
+    uint8_t errors[FRAME_MAX_COUNT];
+    uint8_t rounds[FRAME_MAX_COUNT];
+    uint8_t answers[FRAME_MAX_COUNT];
+
+    /* round 0 marks a guess without an open game, its score is dropped */
+    game_decode(entries + 2, SESSION_REQ_BYTES, count, codes, errors);
+    for (int i = 0; i < count; i++) {
+        uint16_t id = get16(entries + i * SESSION_REQ_BYTES);
+
+        secrets[i] = 0;
+        rounds[i] = 0;
+        if (id < conn->session_size) {
+            secrets[i] = conn->session[id].secret & CODE_MASK;
+            rounds[i] = conn->session[id].round;
+        }
+    }
+    game_answers(secrets, rounds, codes, errors, count, answers);
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t *entry = entries + i * SESSION_REQ_BYTES;
+        uint16_t id = get16(entry);
+        struct session_game *g = rounds[i] != 0 ? &conn->session[id] : NULL;
+        int status;
+
+        put16(out, id);
+        if (g == NULL || g->round == 0) {
+            /* no game, or an earlier guess of the frame ended it */
+            out[2] = ANSWER_NO_GAME;
+        } else if (g->round != rounds[i]) {
+            /* an earlier guess of the frame played the same game */
+            out[2] = session_play(conn, id, entry + 2, totals);
+        } else {
+            out[2] = answers[i];
+            status = game_answer_status(answers[i]);
+            if (status != GAME_RUNNING) {
+                count_outcome(totals, status, g->round);
+                g->round = 0;
+                conn->session_active--;
+            } else {
+                g->round++;
+            }
         }
+        out += SESSION_RESP_BYTES;
     }
+}
+
+static void conn_free(struct conn *conn)
+{
+    if (conn->inbuf != conn->small_in) {
+        free(conn->inbuf);
+    }
+    if (conn->outbuf != conn->small_out) {
+        free(conn->outbuf);
+    }
+    free(conn->session);
+    conn->inbuf = conn->small_in;
+    conn->outbuf = conn->small_out;
+    conn->session = NULL;
+    conn->session_size = 0;
+    conn->session_active = 0;
+}
+
+static int open_listener(long int portno, int backlog, int reuseport)
+{
+    int fd;
 
-    /* Create a new TCP/IP socket `sockfd`, and set the SO_REUSEADDR
-       option for this socket. Then bind the socket to localhost:portno,
-       listen, and wait for new connections, which should be assigned to
-       `connfd`. Terminate the program in case of an error.
-    */
-    
-    
     /* create socket and set options */
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         bail_out(EXIT_FAILURE, "Socket creation failed");
     }
-    
+
     int optval = 1;
-    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof optval);
-    
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof optval);
+    /* inherited by the accepted connections */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof optval);
+    if (reuseport &&
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof optval) < 0) {
+        (void) close(fd);
+        bail_out(EXIT_FAILURE, "setsockopt SO_REUSEPORT");
+    }
+
     /* bind socket to port and address */
     struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof server_addr);  
+    memset(&server_addr, 0, sizeof server_addr);
 
     server_addr.sin_family=AF_INET;
     server_addr.sin_addr.s_addr=INADDR_ANY;
-    server_addr.sin_port=htons(options.portno);
-    
-    if (bind(sockfd, (struct sockaddr *) &server_addr, sizeof(server_addr)) < 0) {
+    server_addr.sin_port=htons(portno);
+
+    if (bind(fd, (struct sockaddr *) &server_addr, sizeof(server_addr)) < 0) {
+        (void) close(fd);
         bail_out(EXIT_FAILURE, "Could not bind to port");
     }
 
-    /* start listening for clients */    
-    if (listen(sockfd, 5) < 0) {
+    /* start listening for clients */
+    if (listen(fd, backlog) < 0) {
+        (void) close(fd);
         bail_out(EXIT_FAILURE, "Could not set socket to passive");
     }
-    
+    return fd;
+}
+
+static int serve_single(struct opts *options)
+{
+    static struct conn conn;
+    struct game_totals session_totals;
+    struct secret_source secrets;
+    int ret;
+
     /* accept a incoming client connection */
-    connfd = accept(sockfd, (struct sockaddr*) &server_addr, (socklen_t *) &server_addr);
+    connfd = accept(sockfd, NULL, NULL);
     if (connfd < 0) {
+        if (quit) return EXIT_SUCCESS; /* caught signal */
         bail_out(EXIT_FAILURE, "Accept socket failed");
     }
+    secrets_init(&secrets, options, 0, 1);
+    conn_init(&conn, connfd, &secrets);
+    memset(&session_totals, 0, sizeof session_totals);
 
     /* accepted the connection */
-    ret = EXIT_SUCCESS;
-    for (round = 1; round <= MAX_TRIES && !quit; ++round) {
-        uint16_t request;
-        static uint8_t buffer[BUFFER_BYTES];
-        int correct_guesses;
-        int error = 0;
-
-        /* read from client */
-        if (read_from_client(connfd, &buffer[0], READ_BYTES) == NULL) {
-            if (quit) break; /* caught signal */
-            bail_out(EXIT_FAILURE, "read_from_client");
+    ret = GAME_RUNNING;
+    while (ret == GAME_RUNNING && !quit) {
+        size_t need;
+
+        /* read from client, a frame arrives as header and body */
+        while ((need = conn_need(&conn)) > conn.inlen) {
+            if (read_from_client(connfd, conn.inbuf + conn.inlen, need - conn.inlen) == NULL) {
+                break;
+            }
+            conn.inlen = need;
         }
-        request = (buffer[1] << 8) | buffer[0];
-        DEBUG("Round %d: Received 0x%x\n", round, request);
-        
-        /* compute answer */
-        correct_guesses = compute_answer(request, buffer, options.secret);
-        if (round == MAX_TRIES && correct_guesses != SLOTS) {
-            buffer[0] |= 1 << GAME_LOST_ERR_BIT;
+        if (need == PROTOCOL_ERROR) {
+            conn_free(&conn);
+            bail_out(EXIT_FAILURE, "Malformed frame");
         }
+        if (need > conn.inlen) {
+            if (quit) break; /* caught signal */
+            if (serve_reaccept(&conn, &secrets)) continue;
+            if (conn.proto != 0 && conn.inlen == 0) break; /* session done */
+            conn_free(&conn);
+            bail_out(EXIT_FAILURE, "read_from_client");
+        }
+        conn.inlen = 0;
+
+        /* compute answer */
+        ret = process_request(&conn, &session_totals);
 
-        DEBUG("Sending byte 0x%x\n", buffer[0]);
+        DEBUG("Sending %zu bytes, first 0x%x\n", conn.outlen, conn.outbuf[0]);
 
         /* send message to client */
-        if (write_to_client(connfd, &buffer[0], WRITE_BYTES) != 0) {
+        if (write_to_client(connfd, conn.outbuf, conn.outlen) != 0) {
             if (quit) break; /* caught signal */
+            if (serve_reaccept(&conn, &secrets)) continue;
+            conn_free(&conn);
             bail_out(EXIT_FAILURE, "write_to_client");
         }
-                
+
         /* We sent the answer to the client; now stop the game
            if its over, or an error occured */
-        if (*buffer & (1<<PARITY_ERR_BIT)) {
+        if (ret == EXIT_PARITY_ERROR || ret == EXIT_MULTIPLE_ERRORS) {
             (void) fprintf(stderr, "Parity error\n");
-            error = 1;
-            ret = EXIT_PARITY_ERROR;
         }
-        if (*buffer & (1 << GAME_LOST_ERR_BIT)) {
+        if (ret == EXIT_GAME_LOST || ret == EXIT_MULTIPLE_ERRORS) {
             (void) fprintf(stderr, "Game lost\n");
-            error = 1;
-            if (ret == EXIT_PARITY_ERROR) {
-                ret = EXIT_MULTIPLE_ERRORS;
-            } else {
-                ret = EXIT_GAME_LOST;
-            }
         }
-        if (error) {
-            break;
-        } else if (correct_guesses == SLOTS) {
+        if (ret == EXIT_SUCCESS) {
             /* won */
-            (void) printf("Runden: %d\n", round);
-            break;
+            (void) printf("Runden: %d\n", conn.game.round);
         }
     }
-    
-    /* we are done */
-    free_resources();
+    if (conn.session != NULL || conn.keepalive) {
+        session_totals.aborted += conn.session_active;
+        (void) printf("Session games: %lu won, %lu lost, %lu parity errors, %lu aborted\n",
+                      session_totals.won, session_totals.lost,
+                      session_totals.parity_errors, session_totals.aborted);
+    }
+    conn_free(&conn);
+    if (ret == GAME_RUNNING) {
+        ret = EXIT_SUCCESS; /* interrupted by a signal or session done */
+    }
     return ret;
 }
 
-static void parse_args(int argc, char **argv, struct opts *options)
+static int serve_reaccept(struct conn *conn, struct secret_source *secrets)
+{
+    if (conn->saved == NULL || conn->game.round == 0 ||
+        !gametable_owns(conn->saved, conn->lease)) {
+        return 0;
+    }
+    DEBUG("Connection dropped in round %d, waiting for the client to resume\n",
+          conn->game.round);
+    conn_free(conn);
+    (void) close(connfd);
+    connfd = accept(sockfd, NULL, NULL);
+    if (connfd < 0) {
+        if (quit) return 1; /* caught signal */
+        bail_out(EXIT_FAILURE, "Accept socket failed");
+    }
+    conn_init(conn, connfd, secrets);
+    return 1;
+}
+
+static void serve_events(struct event_loop *loop)
+{
+    struct epoll_event events[MAX_EVENTS];
+    struct epoll_event ev;
+
+    if (loop->uring) {
+        struct uring ring;
+
+        if (uring_init(&ring, URING_ENTRIES) == 0) {
+            serve_uring(loop, &ring);
+            return;
+        }
+        (void) fprintf(stderr, "%s: io_uring not available, using epoll: %s\n",
+                       progname, strerror(errno));
+        errno = 0;
+        loop->uring = 0;
+    }
+
+    if ((loop->epfd = epoll_create1(0)) < 0) {
+        bail_out(EXIT_FAILURE, "epoll_create1");
+    }
+    if (fcntl(loop->listenfd, F_SETFL, O_NONBLOCK) < 0) {
+        bail_out(EXIT_FAILURE, "fcntl");
+    }
+
+    /* the listening socket is the only entry without a game */
+    memset(&ev, 0, sizeof ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->listenfd, &ev) < 0) {
+        bail_out(EXIT_FAILURE, "epoll_ctl");
+    }
+    loop->accepting = 1;
+    /* worker threads do not see signals, they are woken up by wakefd */
+    if (wakefd[0] >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.ptr = &wakefd;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, wakefd[0], &ev) < 0) {
+            bail_out(EXIT_FAILURE, "epoll_ctl");
+        }
+    }
+
+    while (!quit) {
+        int n = epoll_wait(loop->epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno != EINTR) {
+                bail_out(EXIT_FAILURE, "epoll_wait");
+            }
+            /* caught signal */
+            errno = 0;
+            if (dump && loop->report) {
+                dump = 0;
+                print_stats(loop, 1);
+            }
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                accept_conns(loop);
+            } else if (events[i].data.ptr == (void *) &wakefd) {
+                continue; /* quit is set */
+            } else {
+                handle_conn(loop, events[i].data.ptr, events[i].events);
+            }
+        }
+    }
+
+    /* shut down: drop all running games */
+    while (loop->conns != NULL) {
+        if (conn_abandons(loop->conns)) {
+            loop->totals.aborted++;
+        }
+        close_conn(loop, loop->conns);
+    }
+    (void) close(loop->epfd);
+    loop->epfd = -1;
+}
+
+static void serve_uring(struct event_loop *loop, struct uring *ring)
 {
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+
+    /* accepts are rearmed after every connection, pending accepts and
+       receives make the kernel poll the sockets itself */
+    (void) uring_queue(ring, IORING_OP_ACCEPT, loop->listenfd, NULL, 0, URING_ACCEPT);
+    loop->accepting = 1;
+    /* worker threads do not see signals, they are woken up by wakefd */
+    if (wakefd[0] >= 0) {
+        sqe = uring_queue(ring, IORING_OP_POLL_ADD, wakefd[0], NULL, 0, URING_WAKE);
+        sqe->poll_events = POLLIN;
+    }
+
+    while (!quit) {
+        /* one system call submits everything queued by the last batch
+           of completions and waits for the next one */
+        if (uring_submit(ring, 1) < 0) {
+            if (errno != EINTR) {
+                bail_out(EXIT_FAILURE, "io_uring_enter");
+            }
+            /* caught signal */
+            errno = 0;
+            if (dump && loop->report) {
+                dump = 0;
+                print_stats(loop, 1);
+            }
+            continue;
+        }
+        while ((cqe = uring_cqe(ring)) != NULL) {
+            uint64_t data = cqe->user_data;
+            int res = cqe->res;
+
+            uring_cqe_seen(ring);
+            if (data == URING_ACCEPT) {
+                uring_accepted(loop, ring, res);
+            } else if (data == URING_WAKE) {
+                continue; /* quit is set */
+            } else {
+                uring_completed(loop, ring, (struct conn *) (uintptr_t) data, res);
+            }
+        }
+    }
+
+    /* shut down: closing the ring cancels the pending operations before
+       their connections are freed */
+    uring_free(ring);
+    while (loop->conns != NULL) {
+        if (conn_abandons(loop->conns)) {
+            loop->totals.aborted++;
+        }
+        close_conn(loop, loop->conns);
+    }
+}
+
+static void serve_workers(struct opts *options)
+{
+    struct event_loop *loops;
+    struct timespec start, end;
+    sigset_t blocked, old;
+    double elapsed;
+    int backlog = options->backlog < 0 ? SOMAXCONN : options->backlog;
+    /* the shared memory loop comes after the workers */
+    int count = options->workers + (options->shm ? 1 : 0);
     int i;
-    char *port_arg;
-    char *secret_arg;
-    char *endptr;
-    enum { beige, darkblue, green, orange, red, black, violet, white };
 
-    if(argc > 0) {
-        progname = argv[0];
+    if ((loops = calloc(count, sizeof *loops)) == NULL) {
+        bail_out(EXIT_FAILURE, "calloc");
     }
-    if (argc != 3) {
-        bail_out(EXIT_FAILURE,
-            "Usage: %s <server-port> <secret-sequence>", progname);
+
+    /* open all listeners up front, so a bind error stops the server
+       before any worker runs */
+    for (i = 0; i < options->workers; i++) {
+        worker_fds[i] = open_listener(options->portno, backlog, 1);
+        worker_count++;
+        loops[i].listenfd = worker_fds[i];
+        secrets_init(&loops[i].secrets, options, i, count);
+        loops[i].uring = options->uring;
+    }
+    if (options->shm) {
+        if ((shm = shm_create(options->portno)) == NULL) {
+            bail_out(EXIT_FAILURE, "shm_create");
+        }
+        shm_port = options->portno;
+        loops[i].listenfd = -1;
+        loops[i].shm = shm;
+        secrets_init(&loops[i].secrets, options, i, count);
+    }
+    if (pipe(wakefd) < 0) {
+        bail_out(EXIT_FAILURE, "pipe");
     }
-    port_arg = argv[1];
-    secret_arg = argv[2];
 
+    /* signals are only handled by the main thread, the workers inherit
+       the blocked mask */
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGUSR1);
+    sigaddset(&blocked, SIGALRM);
+    if (pthread_sigmask(SIG_BLOCK, &blocked, &old) != 0) {
+        bail_out(EXIT_FAILURE, "pthread_sigmask");
+    }
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; i++) {
+        if ((errno = pthread_create(&loops[i].thread, NULL, worker_main, &loops[i])) != 0) {
+            bail_out(EXIT_FAILURE, "pthread_create");
+        }
+    }
+
+    while (!quit) {
+        (void) sigsuspend(&old);
+        if (dump) {
+            dump = 0;
+            print_stats(loops, count);
+        }
+    }
     errno = 0;
-    options->portno = strtol(port_arg, &endptr, 10);
+    if (write(wakefd[1], "q", 1) < 0) {
+        bail_out(EXIT_FAILURE, "write wakefd");
+    }
+    if (shm != NULL) {
+        shm_stop(shm);
+    }
+    for (i = 0; i < count; i++) {
+        (void) pthread_join(loops[i].thread, NULL);
+    }
+    (void) clock_gettime(CLOCK_MONOTONIC, &end);
 
-    if ((errno == ERANGE &&
-          (options->portno == LONG_MAX || options->portno == LONG_MIN))
-        || (errno != 0 && options->portno == 0)) {
-        bail_out(EXIT_FAILURE, "strtol");
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    for (i = 0; i < count; i++) {
+        struct game_totals *t = &loops[i].totals;
+        unsigned long games = t->won + t->lost + t->parity_errors + t->aborted;
+
+        if (loops[i].shm != NULL) {
+            (void) printf("Shared memory: ");
+        } else {
+            (void) printf("Worker %d: ", i);
+        }
+        (void) printf("%lu games (%lu won, %lu lost, %lu parity errors, "
+                      "%lu aborted), %.1f games/s\n", games, t->won, t->lost,
+                      t->parity_errors, t->aborted, games / elapsed);
     }
+    print_stats(loops, count);
+    free(loops);
+}
 
-    if (endptr == port_arg) {
-        bail_out(EXIT_FAILURE, "No digits were found");
+static void serve_shm(struct event_loop *loop)
+{
+    struct shm_region *region = loop->shm;
+    /* the region is new, every channel starts free without a game */
+    struct game games[SHM_CHANNELS];
+    uint32_t owners[SHM_CHANNELS];
+    int limit = shm_spins();
+    int idle = 0;
+
+    memset(games, 0, sizeof games);
+    memset(owners, 0, sizeof owners);
+    while (!__atomic_load_n(&region->quit, __ATOMIC_ACQUIRE)) {
+        uint32_t doorbell = shm_doorbell(region);
+        int polling = 0;
+
+        if (shm_serve_channels(loop, games, owners, &polling) > 0) {
+            idle = 0;
+            continue;
+        }
+        /* spin a little after the last request, keep looking while a
+           client polls */
+        if (idle++ < limit) {
+            shm_relax();
+            continue;
+        }
+        if (polling) {
+            (void) sched_yield();
+            continue;
+        }
+        shm_server_wait(region, doorbell, shm_pending, region);
+        idle = 0;
     }
 
-    /* If we got here, strtol() successfully parsed a number */
+    /* shut down: drop all running games */
+    for (int i = 0; i < SHM_CHANNELS; i++) {
+        if ((owners[i] & 1) && games[i].round != 0) {
+            loop->totals.aborted++;
+        }
+    }
+}
 
-    if (*endptr != '\0') { /* In principle not necessarily an error... */
-        bail_out(EXIT_FAILURE,
-            "Further characters after <server-port>: %s", endptr);
+static int shm_serve_channels(struct event_loop *loop, struct game *games,
+                              uint32_t *owners, int *polling)
+{
+    struct shm_region *region = loop->shm;
+    int answered = 0;
+
+    for (int i = 0; i < SHM_CHANNELS; i++) {
+        struct shm_channel *channel = &region->channels[i];
+        struct game *game = &games[i];
+        uint8_t guess[GUESS_BYTES];
+        uint8_t answer;
+        code_t request;
+        uint32_t owner;
+        uint64_t start;
+        int pending;
+        int status;
+
+        /* the owner is read after the request: a client claims the channel
+           before it sends, so a request is never taken for the last game */
+        pending = shm_request(channel, &request);
+        owner = __atomic_load_n(&channel->owner, __ATOMIC_ACQUIRE);
+        if (owner != owners[i]) {
+            /* the client of the last game left before it was over */
+            if ((owners[i] & 1) && game->round != 0) {
+                loop->totals.aborted++;
+            }
+            owners[i] = owner;
+            game->round = 0;
+            if (owner & 1) {
+                game->round = 1;
+                game->secret = secret_next(&loop->secrets);
+            }
+        }
+        if ((owner & 1) && game->round != 0 && channel->poll) {
+            *polling = 1;
+        }
+        if (!pending) {
+            continue;
+        }
+
+        start = now_ns();
+        if (game->round == 0) {
+            answer = ANSWER_NO_GAME;
+        } else {
+            put_code(guess, request);
+            (void) answer_guesses(game, guess, 1, &answer, &status);
+            if (status != GAME_RUNNING) {
+                count_outcome(&loop->totals, status, game->round);
+                game->round = 0;
+            }
+        }
+        histogram_record(&loop->stats.compute, now_ns() - start);
+        shm_answer(channel, answer);
+        answered++;
     }
+    return answered;
+}
 
-    /* check for valid port range */
-    if (options->portno < 1 || options->portno > 65535)
-    {
-        bail_out(EXIT_FAILURE, "Use a valid TCP/IP port range (1-65535)");
+static int shm_pending(void *arg)
+{
+    struct shm_region *region = arg;
+
+    for (int i = 0; i < SHM_CHANNELS; i++) {
+        struct shm_channel *channel = &region->channels[i];
+
+        if (__atomic_load_n(&channel->req_tail, __ATOMIC_SEQ_CST) != channel->req_head) {
+            return 1;
+        }
     }
+    return 0;
+}
 
-    if (strlen(secret_arg) != SLOTS) {
-        bail_out(EXIT_FAILURE,
-            "<secret-sequence> has to be %d chars long", SLOTS);
+static void *worker_main(void *arg)
+{
+    struct event_loop *loop = arg;
+
+    if (loop->shm != NULL) {
+        serve_shm(loop);
+    } else {
+        serve_events(loop);
     }
+    return NULL;
+}
 
-    /* read secret */
-    for (i = 0; i < SLOTS; ++i) {
-        uint8_t color;
-        switch (secret_arg[i]) {
-        case 'b':
-            color = beige;
+static void print_stats(struct event_loop *loops, int count)
+{
+    /* large histograms, only used by the main thread */
+    static struct game_totals sum;
+    static struct loop_stats stats;
+    unsigned long rounds = 0;
+
+    /* the counters of running loops are read without locking: each one is
+       an aligned word written by a single thread, so a dump may miss the
+       latest events but never sees a torn count */
+    memset(&sum, 0, sizeof sum);
+    memset(&stats, 0, sizeof stats);
+    for (int i = 0; i < count; i++) {
+        struct game_totals *t = &loops[i].totals;
+
+        sum.won += t->won;
+        sum.lost += t->lost;
+        sum.parity_errors += t->parity_errors;
+        sum.aborted += t->aborted;
+        for (int r = 1; r <= MAX_TRIES; r++) {
+            sum.rounds[r] += t->rounds[r];
+        }
+        histogram_merge(&stats.read, &loops[i].stats.read);
+        histogram_merge(&stats.compute, &loops[i].stats.compute);
+        histogram_merge(&stats.write, &loops[i].stats.write);
+    }
+
+    (void) printf("Games: %lu won, %lu lost, %lu parity errors, %lu aborted\n",
+                  sum.won, sum.lost, sum.parity_errors, sum.aborted);
+    (void) printf("Rounds to win:");
+    for (int r = 1; r <= MAX_TRIES; r++) {
+        if (sum.rounds[r] != 0) {
+            (void) printf(" %d: %lu", r, sum.rounds[r]);
+            rounds += r * sum.rounds[r];
+        }
+    }
+    if (sum.won != 0) {
+        (void) printf(", avg %.3f", (double) rounds / sum.won);
+    }
+    (void) printf("\n");
+    print_latency("Read", &stats.read);
+    print_latency("Compute", &stats.compute);
+    print_latency("Write", &stats.write);
+    (void) fflush(stdout);
+}
+
+static void print_latency(const char *name, const struct histogram *histogram)
+{
+    (void) printf("%s latency: p50 %llu, p99 %llu, p99.9 %llu, max %llu ns (%llu)\n",
+                  name,
+                  (unsigned long long) histogram_percentile(histogram, 50),
+                  (unsigned long long) histogram_percentile(histogram, 99),
+                  (unsigned long long) histogram_percentile(histogram, 99.9),
+                  (unsigned long long) histogram->max,
+                  (unsigned long long) histogram->total);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void accept_conns(struct event_loop *loop)
+{
+    for (;;) {
+        struct epoll_event ev;
+        struct conn *conn;
+        int fd;
+
+        fd = accept(loop->listenfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                errno = 0;
+                return;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE) {
+                /* out of descriptors - the pending connection keeps the
+                   listener readable, stop polling it until a game finished */
+                DEBUG("accept: %s\n", strerror(errno));
+                errno = 0;
+                listener_poll(loop, 0);
+                return;
+            }
+            bail_out(EXIT_FAILURE, "Accept socket failed");
+        }
+        if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+            bail_out(EXIT_FAILURE, "fcntl");
+        }
+
+        if ((conn = malloc(sizeof *conn)) == NULL) {
+            (void) close(fd);
+            bail_out(EXIT_FAILURE, "malloc");
+        }
+        conn_init(conn, fd, &loop->secrets);
+
+        memset(&ev, 0, sizeof ev);
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            (void) close(fd);
+            free(conn);
+            bail_out(EXIT_FAILURE, "epoll_ctl");
+        }
+
+        conn->next = loop->conns;
+        if (loop->conns != NULL) {
+            loop->conns->prev = conn;
+        }
+        loop->conns = conn;
+        DEBUG("Accepted game on fd %d\n", fd);
+    }
+}
+
+static void handle_conn(struct event_loop *loop, struct conn *conn, uint32_t events)
+{
+    if (events & EPOLLOUT) {
+        int r = flush_conn(loop, conn);
+        if (r < 0 || (r == 0 && conn->over)) {
+            close_conn(loop, conn);
+        }
+        return;
+    }
+
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        size_t need = conn_need(conn);
+        uint64_t start, received;
+        ssize_t r;
+
+        start = now_ns();
+        r = recv(conn->fd, conn->inbuf + conn->inlen, need - conn->inlen, 0);
+        received = now_ns();
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            errno = 0;
+            return;
+        }
+        if (r <= 0) {
+            /* client went away in the middle of the game */
+            errno = 0;
+            if (conn_abandons(conn)) {
+                loop->totals.aborted++;
+            }
+            close_conn(loop, conn);
+            return;
+        }
+        conn->inlen += r;
+        histogram_record(&loop->stats.read, received - start);
+        if (conn_received(loop, conn, &received) <= 0) {
+            return;
+        }
+
+        r = flush_conn(loop, conn);
+        histogram_record(&loop->stats.write, now_ns() - received);
+        if (r < 0 || (r == 0 && conn->over)) {
+            close_conn(loop, conn);
+        }
+    }
+}
+
+static int conn_received(struct event_loop *loop, struct conn *conn, uint64_t *clock)
+{
+    uint64_t start;
+    size_t need;
+    int status;
+
+    /* a complete frame header tells the size of the frame body */
+    if ((need = conn_need(conn)) == PROTOCOL_ERROR) {
+        DEBUG("fd %d: malformed frame\n", conn->fd);
+        loop->totals.aborted++;
+        close_conn(loop, conn);
+        return -1;
+    }
+    if (conn->inlen < need) {
+        /* a client may hold back the rest until the part is acked */
+        int optval = 1;
+        (void) setsockopt(conn->fd, IPPROTO_TCP, TCP_QUICKACK, &optval, sizeof optval);
+        return 0;
+    }
+    conn->inlen = 0;
+
+    conn->outoff = 0;
+    status = process_request(conn, &loop->totals);
+    if (status != GAME_RUNNING) {
+        DEBUG("fd %d: game over after %d rounds (%d)\n",
+              conn->fd, conn->game.round, status);
+        count_outcome(&loop->totals, status, conn->game.round);
+        conn->over = 1;
+    }
+    start = *clock;
+    *clock = now_ns();
+    histogram_record(&loop->stats.compute, *clock - start);
+    return 1;
+}
+
+static struct io_uring_sqe *uring_queue(struct uring *ring, int opcode, int fd,
+                                        void *addr, unsigned len, uint64_t data)
+{
+    struct io_uring_sqe *sqe = uring_sqe(ring);
+
+    if (sqe == NULL) {
+        bail_out(EXIT_FAILURE, "io_uring_enter");
+    }
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t) addr;
+    sqe->len = len;
+    sqe->user_data = data;
+    return sqe;
+}
+
+static void uring_transfer(struct uring *ring, struct conn *conn)
+{
+    struct io_uring_sqe *sqe;
+
+    if (conn->outlen != 0) {
+        sqe = uring_queue(ring, IORING_OP_SEND, conn->fd, conn->outbuf + conn->outoff,
+                          conn->outlen - conn->outoff, (uintptr_t) conn);
+        sqe->msg_flags = MSG_NOSIGNAL;
+    } else {
+        /* receive straight into the request buffer, no more than the
+           request needs */
+        (void) uring_queue(ring, IORING_OP_RECV, conn->fd, conn->inbuf + conn->inlen,
+                           conn_need(conn) - conn->inlen, (uintptr_t) conn);
+    }
+}
+
+static void uring_accepted(struct event_loop *loop, struct uring *ring, int fd)
+{
+    struct conn *conn;
+
+    loop->accepting = 0;
+    if (fd < 0) {
+        if (fd == -EMFILE || fd == -ENFILE) {
+            /* out of descriptors - rearmed once a game finished */
+            DEBUG("accept: %s\n", strerror(-fd));
+            return;
+        }
+        if (fd != -EINTR && fd != -ECONNABORTED && fd != -EAGAIN) {
+            errno = -fd;
+            bail_out(EXIT_FAILURE, "Accept socket failed");
+        }
+    } else {
+        if ((conn = malloc(sizeof *conn)) == NULL) {
+            (void) close(fd);
+            bail_out(EXIT_FAILURE, "malloc");
+        }
+        conn_init(conn, fd, &loop->secrets);
+        conn->next = loop->conns;
+        if (loop->conns != NULL) {
+            loop->conns->prev = conn;
+        }
+        loop->conns = conn;
+        DEBUG("Accepted game on fd %d\n", fd);
+        uring_transfer(ring, conn);
+    }
+    (void) uring_queue(ring, IORING_OP_ACCEPT, loop->listenfd, NULL, 0, URING_ACCEPT);
+    loop->accepting = 1;
+}
+
+static void uring_completed(struct event_loop *loop, struct uring *ring,
+                            struct conn *conn, int res)
+{
+    uint64_t received;
+
+    if (res == -EINTR || res == -EAGAIN) {
+        uring_transfer(ring, conn); /* retry */
+        return;
+    }
+
+    if (conn->outlen != 0) {
+        /* send completed */
+        if (res >= 0 && (conn->outoff += res) < conn->outlen) {
+            uring_transfer(ring, conn);
+            return;
+        }
+        if (res >= 0 && !conn->over) {
+            conn->outoff = conn->outlen = 0;
+            uring_transfer(ring, conn);
+            return;
+        }
+        if (res < 0 && !conn->over) {
+            loop->totals.aborted++;
+        }
+        close_conn(loop, conn);
+    } else if (res > 0) {
+        /* receive completed */
+        received = now_ns();
+        conn->inlen += res;
+        if (conn_received(loop, conn, &received) >= 0) {
+            /* the rest of the request or the response */
+            uring_transfer(ring, conn);
+            return;
+        }
+    } else {
+        /* client went away in the middle of the game */
+        if (conn_abandons(conn)) {
+            loop->totals.aborted++;
+        }
+        close_conn(loop, conn);
+    }
+
+    /* a descriptor was freed, accept again */
+    if (!loop->accepting) {
+        (void) uring_queue(ring, IORING_OP_ACCEPT, loop->listenfd, NULL, 0, URING_ACCEPT);
+        loop->accepting = 1;
+    }
+}
+
+static int flush_conn(struct event_loop *loop, struct conn *conn)
+{
+    struct epoll_event ev;
+    int waiting = 0;
+
+    while (conn->outoff < conn->outlen) {
+        ssize_t s = send(conn->fd, conn->outbuf + conn->outoff,
+                         conn->outlen - conn->outoff, MSG_NOSIGNAL);
+        if (s < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                errno = 0;
+                if (!conn->over) {
+                    loop->totals.aborted++;
+                }
+                return -1;
+            }
+            errno = 0;
+            waiting = 1;
             break;
-        case 'd':
-            color = darkblue;
+        }
+        conn->outoff += s;
+    }
+
+    /* stop reading while a response is pending, resume once it is sent */
+    if (waiting != conn->waiting) {
+        memset(&ev, 0, sizeof ev);
+        ev.events = waiting ? EPOLLOUT : EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+            bail_out(EXIT_FAILURE, "epoll_ctl");
+        }
+        conn->waiting = waiting;
+    }
+    if (!waiting) {
+        conn->outoff = conn->outlen = 0;
+    }
+    return waiting;
+}
+
+static void close_conn(struct event_loop *loop, struct conn *conn)
+{
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    } else {
+        loop->conns = conn->next;
+    }
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+    /* session games still running are lost with the connection */
+    loop->totals.aborted += conn->session_active;
+    /* closing the descriptor also removes it from the epoll set */
+    (void) close(conn->fd);
+    conn_free(conn);
+    free(conn);
+    /* a descriptor was freed, accept again (io_uring rearms its accept
+       itself) */
+    if (!loop->uring && !loop->accepting) {
+        listener_poll(loop, EPOLLIN);
+    }
+}
+
+static void listener_poll(struct event_loop *loop, uint32_t events)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof ev);
+    ev.events = events;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, loop->listenfd, &ev) < 0) {
+        bail_out(EXIT_FAILURE, "epoll_ctl");
+    }
+    loop->accepting = events != 0;
+}
+
+static void bail_out(int exitcode, const char *fmt, ...)
+{
+    va_list ap;
+
+    (void) fprintf(stderr, "%s: ", progname);
+    if (fmt != NULL) {
+        va_start(ap, fmt);
+        (void) vfprintf(stderr, fmt, ap);
+        va_end(ap);
+    }
+    if (errno != 0) {
+        (void) fprintf(stderr, ": %s", strerror(errno));
+    }
+    (void) fprintf(stderr, "\n");
+
+    free_resources();
+    exit(exitcode);
+}
+
+static void free_resources(void)
+{
+    /* clean up resources */
+    DEBUG("Shutting down server\n");
+    if(connfd >= 0) {
+        (void) close(connfd);
+    }
+    if(sockfd >= 0) {
+        (void) close(sockfd);
+    }
+    for (int i = 0; i < worker_count; i++) {
+        (void) close(worker_fds[i]);
+    }
+    worker_count = 0;
+    codelist_close(&secret_list);
+    gametable_close(&game_table);
+    if (shm != NULL) {
+        shm_stop(shm);
+        shm_destroy(shm, shm_port);
+        shm = NULL;
+    }
+    for (int i = 0; i < COUNT_OF(wakefd); i++) {
+        if (wakefd[i] >= 0) {
+            (void) close(wakefd[i]);
+            wakefd[i] = -1;
+        }
+    }
+}
+
+static void signal_handler(int sig)
+{
+    if (sig == SIGUSR1 || sig == SIGALRM) {
+        dump = 1;
+    } else {
+        quit = 1;
+    }
+}
+
+/**
+ * main
+ * @brief Program entry point
+ * @param argc The argument counter
+ * @param argv The argument vector
+ * @return EXIT_SUCCESS on success, EXIT_PARITY_ERROR in case of an parity
+ * error, EXIT_GAME_LOST in case client needed to many guesses,
+ * EXIT_MULTIPLE_ERRORS in case multiple errors occured in one round,
+ * EXIT_FAILURE if socket creation failed
+ */
+int main(int argc, char *argv[])
+{
+
+    struct opts options;
+    int ret;
+
+    parse_args(argc, argv, &options);
+    score_init();
+
+    /* setup signal handlers */
+    const int signals[] = {SIGINT, SIGTERM};
+    struct sigaction s;
+
+    s.sa_handler = signal_handler;
+    s.sa_flags   = 0;
+    if(sigfillset(&s.sa_mask) < 0) {
+        bail_out(EXIT_FAILURE, "sigfillset");
+    }
+    for(int i = 0; i < COUNT_OF(signals); i++) {
+        if (sigaction(signals[i], &s, NULL) < 0) {
+            bail_out(EXIT_FAILURE, "sigaction");
+        }
+    }
+
+    /* Create a new TCP/IP socket `sockfd`, and set the SO_REUSEADDR
+       option for this socket. Then bind the socket to localhost:portno,
+       listen, and wait for new connections, which should be assigned to
+       `connfd`. Terminate the program in case of an error.
+    */
+    if (!options.event_mode) {
+        /* a saved game outlives a client closing early */
+        s.sa_handler = SIG_IGN;
+        if (options.table_file != NULL && sigaction(SIGPIPE, &s, NULL) < 0) {
+            bail_out(EXIT_FAILURE, "sigaction");
+        }
+        sockfd = open_listener(options.portno,
+                               options.backlog < 0 ? BACKLOG : options.backlog, 0);
+        ret = serve_single(&options);
+    } else {
+        /* a client closing early must not kill the whole server */
+        s.sa_handler = SIG_IGN;
+        if (sigaction(SIGPIPE, &s, NULL) < 0) {
+            bail_out(EXIT_FAILURE, "sigaction");
+        }
+
+        /* statistics dumps on request and every interval */
+        s.sa_handler = signal_handler;
+        if (sigaction(SIGUSR1, &s, NULL) < 0 || sigaction(SIGALRM, &s, NULL) < 0) {
+            bail_out(EXIT_FAILURE, "sigaction");
+        }
+        if (options.interval > 0) {
+            struct itimerval timer;
+
+            memset(&timer, 0, sizeof timer);
+            timer.it_interval.tv_sec = options.interval;
+            timer.it_value.tv_sec = options.interval;
+            if (setitimer(ITIMER_REAL, &timer, NULL) < 0) {
+                bail_out(EXIT_FAILURE, "setitimer");
+            }
+        }
+
+        if (options.workers > 1 || options.shm) {
+            serve_workers(&options);
+        } else {
+            struct event_loop loop;
+
+            sockfd = open_listener(options.portno,
+                                   options.backlog < 0 ? SOMAXCONN : options.backlog, 0);
+            memset(&loop, 0, sizeof loop);
+            loop.listenfd = sockfd;
+            secrets_init(&loop.secrets, &options, 0, 1);
+            loop.report = 1;
+            loop.uring = options.uring;
+            serve_events(&loop);
+            print_stats(&loop, 1);
+        }
+        ret = EXIT_SUCCESS;
+    }
+
+    /* we are done */
+    free_resources();
+    return ret;
+}
+
+static void parse_args(int argc, char **argv, struct opts *options)
+{
+    int i;
+    char *port_arg;
+    char *secret_arg;
+    int c;
+
+    if(argc > 0) {
+        progname = argv[0];
+    }
+    options->event_mode = 0;
+    options->workers = 1;
+    options->backlog = -1;
+    options->interval = 0;
+    options->uring = 0;
+    options->shm = 0;
+    options->secrets = SECRET_FIXED;
+    options->secret_file = NULL;
+    options->table_file = NULL;
+    while ((c = getopt(argc, argv, "et:b:i:umr:s:g:")) != -1) {
+        switch (c) {
+        case 'e':
+            options->event_mode = 1;
             break;
-        case 'g':
-            color = green;
+        case 't':
+            options->event_mode = 1;
+            options->workers = parse_number(optarg, "<threads>", 1, MAX_WORKERS);
             break;
-        case 'o':
-            color = orange;
+        case 'b':
+            options->backlog = parse_number(optarg, "<backlog>", 1, INT_MAX);
             break;
         case 'r':
-            color = red;
+            options->secrets = SECRET_RANDOM;
+            options->seed = parse_number(optarg, "<seed>", 0, LONG_MAX);
             break;
         case 's':
-            color = black;
+            options->secrets = SECRET_LIST;
+            options->secret_file = optarg;
+            break;
+        case 'u':
+            options->event_mode = 1;
+            options->uring = 1;
             break;
-        case 'v':
-            color = violet;
+        case 'm':
+            options->event_mode = 1;
+            options->shm = 1;
             break;
-        case 'w':
-            color = white;
+        case 'i':
+            options->event_mode = 1;
+            options->interval = parse_number(optarg, "<seconds>", 1, INT_MAX);
+            break;
+        case 'g':
+            options->table_file = optarg;
             break;
         default:
-            color = '\n'; // silence compiler warning
+            usage();
+        }
+    }
+    /* -r and -s take the place of the <secret-sequence> */
+    if (argc - optind != (options->secrets == SECRET_FIXED ? 2 : 1)) {
+        usage();
+    }
+    port_arg = argv[optind];
+
+    options->portno = parse_number(port_arg, "<server-port>", 1, 65535);
+
+    if (options->table_file != NULL && gametable_open(options->table_file, &game_table) < 0) {
+        bail_out(EXIT_FAILURE, "Could not load game table %s", options->table_file);
+    }
+
+    if (options->secrets == SECRET_LIST) {
+        if (codelist_open(options->secret_file, &secret_list) < 0) {
+            bail_out(EXIT_FAILURE, "Could not load secret list %s", options->secret_file);
+        }
+        return;
+    }
+    if (options->secrets == SECRET_RANDOM) {
+        return;
+    }
+    secret_arg = argv[optind + 1];
+
+    if (strlen(secret_arg) != SLOTS) {
+        bail_out(EXIT_FAILURE,
+            "<secret-sequence> has to be %d chars long", SLOTS);
+    }
+
+    /* read secret */
+    options->secret = 0;
+    for (i = 0; i < SLOTS; ++i) {
+        const char *color = memchr(COLOR_LETTERS, secret_arg[i], COLORS);
+        if (color == NULL) {
             bail_out(EXIT_FAILURE,
                 "Bad Color '%c' in <secret-sequence>", secret_arg[i]);
         }
-        options->secret[i] = color;
+        options->secret |= (code_t) (color - COLOR_LETTERS) << (i * SHIFT_WIDTH);
+    }
+}
+
+static void secrets_init(struct secret_source *source, struct opts *options,
+                         int index, int count)
+{
+    switch (options->secrets) {
+    case SECRET_RANDOM:
+        secret_random(source, options->seed, index);
+        break;
+    case SECRET_LIST:
+        /* the threads interleave, together they go through the list in order */
+        secret_iterate(source, &secret_list, index, count);
+        break;
+    default:
+        secret_fixed(source, options->secret);
+        break;
+    }
+}
+
+static long int parse_number(const char *arg, const char *name, long int min, long int max)
+{
+    char *endptr;
+    long int value;
+
+    errno = 0;
+    value = strtol(arg, &endptr, 10);
+
+    if ((errno == ERANGE && (value == LONG_MAX || value == LONG_MIN))
+        || (errno != 0 && value == 0)) {
+        bail_out(EXIT_FAILURE, "strtol");
     }
+
+    if (endptr == arg) {
+        bail_out(EXIT_FAILURE, "No digits were found in %s", name);
+    }
+
+    /* If we got here, strtol() successfully parsed a number */
+
+    if (*endptr != '\0') { /* In principle not necessarily an error... */
+        bail_out(EXIT_FAILURE, "Further characters after %s: %s", name, endptr);
+    }
+
+    if (value < min || value > max) {
+        bail_out(EXIT_FAILURE, "%s has to be in range %ld-%ld", name, min, max);
+    }
+    return value;
+}
+
+static void usage(void)
+{
+    bail_out(EXIT_FAILURE,
+        "Usage: %s [-e] [-t <threads>] [-u] [-m] [-b <backlog>] [-i <seconds>] "
+        "[-g <file>] [-r <seed> | -s <file>] <server-port> [<secret-sequence>]",
+        progname);
 }
@@ -0,0 +1,285 @@
+/**
+ * @file shmring.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief shared memory transport of the legacy protocol for clients on the
+ * server's host
+ *
+ * @details
+ *    a sleeping side sets its sleeping flag, looks for work once more and
+ *    then waits on a futex word (the doorbell or resp_tail) with the value
+ *    it read before looking. A producer publishes first and reads the flag
+ *    afterwards, both with sequentially consistent atomics, so either the
+ *    sleeper finds the work or the producer sees the flag and wakes it
+ *
+ * @date 17.10.2015
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "shmring.h"
+
+/* === Constants === */
+
+/* longest sleep of a client before it checks that the server is alive, in ms */
+#define CLIENT_SLEEP_MS (100)
+
+/* === Prototypes === */
+
+/**
+ * shm_map
+ * @brief Map the region of a port
+ * @param port The server port
+ * @param flags Flags of shm_open()
+ * @return The region, NULL with errno set on error
+ */
+static struct shm_region *shm_map(long port, int flags);
+
+/**
+ * futex_wait
+ * @brief Sleep while a shared word holds a value
+ * @param word The word
+ * @param value The value
+ * @param ms Longest sleep in ms, -1 for none
+ */
+static void futex_wait(uint32_t *word, uint32_t value, int ms);
+
+/**
+ * futex_wake
+ * @brief Wake all processes sleeping on a shared word
+ * @param word The word
+ */
+static void futex_wake(uint32_t *word);
+
+/* === Implementations === */
+
+struct shm_region *shm_create(long port)
+{
+    struct shm_region *region;
+    char name[32];
+
+    (void) snprintf(name, sizeof name, SHM_NAME_FORMAT, port);
+    /* a region left behind by a server that was killed */
+    (void) shm_unlink(name);
+    if ((region = shm_map(port, O_RDWR | O_CREAT | O_EXCL)) == NULL) {
+        return NULL;
+    }
+    /* the new region is zero filled, every channel free */
+    region->version = SHM_VERSION;
+    region->slots = SLOTS;
+    region->colors = COLORS;
+    region->code_bytes = sizeof(code_t);
+    region->server = getpid();
+    __atomic_store_n(&region->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    return region;
+}
+
+struct shm_region *shm_attach(long port)
+{
+    struct shm_region *region;
+
+    if ((region = shm_map(port, O_RDWR)) == NULL) {
+        return NULL;
+    }
+    if (__atomic_load_n(&region->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC ||
+        region->version != SHM_VERSION || region->slots != SLOTS ||
+        region->colors != COLORS || region->code_bytes != sizeof(code_t)) {
+        shm_detach(region);
+        errno = EINVAL;
+        return NULL;
+    }
+    return region;
+}
+
+void shm_detach(struct shm_region *region)
+{
+    (void) munmap(region, sizeof *region);
+}
+
+void shm_stop(struct shm_region *region)
+{
+    __atomic_store_n(&region->quit, 1, __ATOMIC_SEQ_CST);
+    /* a server about to sleep sees the doorbell change */
+    __atomic_add_fetch(&region->doorbell, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&region->doorbell);
+    for (int i = 0; i < SHM_CHANNELS; i++) {
+        futex_wake(&region->channels[i].resp_tail);
+    }
+}
+
+void shm_destroy(struct shm_region *region, long port)
+{
+    char name[32];
+
+    (void) snprintf(name, sizeof name, SHM_NAME_FORMAT, port);
+    (void) shm_unlink(name);
+    shm_detach(region);
+}
+
+struct shm_channel *shm_claim(struct shm_region *region, int poll)
+{
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < SHM_CHANNELS; i++) {
+            struct shm_channel *channel = &region->channels[i];
+            uint32_t owner = __atomic_load_n(&channel->owner, __ATOMIC_ACQUIRE);
+
+            if (owner & 1) {
+                /* second pass: the owner exited without releasing it */
+                if (pass == 0 || kill(channel->pid, 0) == 0 || errno != ESRCH) {
+                    continue;
+                }
+                if (!__atomic_compare_exchange_n(&channel->owner, &owner, owner + 1, 0,
+                                                 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                    continue;
+                }
+                owner++;
+                /* drop what the dead client left in the rings */
+                channel->resp_head = __atomic_load_n(&channel->resp_tail, __ATOMIC_ACQUIRE);
+                channel->req_tail = __atomic_load_n(&channel->req_head, __ATOMIC_ACQUIRE);
+            }
+            if (__atomic_compare_exchange_n(&channel->owner, &owner, owner + 1, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                channel->pid = getpid();
+                __atomic_store_n(&channel->poll, poll, __ATOMIC_RELAXED);
+                return channel;
+            }
+        }
+    }
+    return NULL;
+}
+
+void shm_release(struct shm_channel *channel)
+{
+    __atomic_store_n(&channel->poll, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&channel->owner, 1, __ATOMIC_RELEASE);
+}
+
+int shm_send(struct shm_region *region, struct shm_channel *channel, code_t guess)
+{
+    uint32_t tail = channel->req_tail;
+
+    if (tail - __atomic_load_n(&channel->req_head, __ATOMIC_ACQUIRE) == SHM_RING_SLOTS) {
+        return -1;
+    }
+    channel->requests[tail % SHM_RING_SLOTS] = guess;
+    __atomic_store_n(&channel->req_tail, tail + 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&region->doorbell, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&region->server_sleeping, __ATOMIC_SEQ_CST)) {
+        futex_wake(&region->doorbell);
+    }
+    return 0;
+}
+
+int shm_receive(struct shm_region *region, struct shm_channel *channel, uint8_t *answer)
+{
+    uint32_t head = channel->resp_head;
+    uint32_t tail;
+    int limit = shm_spins();
+    int spins = 0;
+
+    while ((tail = __atomic_load_n(&channel->resp_tail, __ATOMIC_ACQUIRE)) == head) {
+        if (__atomic_load_n(&region->quit, __ATOMIC_ACQUIRE)) {
+            return -1;
+        }
+        if (spins++ < limit) {
+            shm_relax();
+            continue;
+        }
+        if (channel->poll) {
+            (void) sched_yield();
+            continue;
+        }
+        __atomic_store_n(&channel->client_sleeping, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&channel->resp_tail, __ATOMIC_SEQ_CST) == head) {
+            futex_wait(&channel->resp_tail, head, CLIENT_SLEEP_MS);
+        }
+        __atomic_store_n(&channel->client_sleeping, 0, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&channel->resp_tail, __ATOMIC_ACQUIRE) == head &&
+            kill(region->server, 0) < 0 && errno == ESRCH) {
+            return -1;
+        }
+    }
+    *answer = channel->answers[head % SHM_RING_SLOTS];
+    __atomic_store_n(&channel->resp_head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void shm_answer(struct shm_channel *channel, uint8_t answer)
+{
+    uint32_t tail = channel->resp_tail;
+
+    /* the client takes every answer before its next request, so there is room */
+    channel->answers[tail % SHM_RING_SLOTS] = answer;
+    __atomic_store_n(&channel->resp_tail, tail + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&channel->client_sleeping, __ATOMIC_SEQ_CST)) {
+        futex_wake(&channel->resp_tail);
+    }
+}
+
+int shm_spins(void)
+{
+    static int spins = -1;
+
+    if (spins < 0) {
+        spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SHM_SPINS : 0;
+    }
+    return spins;
+}
+
+void shm_server_wait(struct shm_region *region, uint32_t doorbell,
+                     int (*pending)(void *arg), void *arg)
+{
+    __atomic_store_n(&region->server_sleeping, 1, __ATOMIC_SEQ_CST);
+    if (!pending(arg)) {
+        futex_wait(&region->doorbell, doorbell, -1);
+    }
+    __atomic_store_n(&region->server_sleeping, 0, __ATOMIC_RELAXED);
+}
+
+static struct shm_region *shm_map(long port, int flags)
+{
+    struct shm_region *region;
+    char name[32];
+    int fd;
+
+    (void) snprintf(name, sizeof name, SHM_NAME_FORMAT, port);
+    if ((fd = shm_open(name, flags, 0600)) < 0) {
+        return NULL;
+    }
+    if ((flags & O_CREAT) && ftruncate(fd, sizeof *region) < 0) {
+        (void) close(fd);
+        (void) shm_unlink(name);
+        return NULL;
+    }
+    region = mmap(NULL, sizeof *region, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    (void) close(fd);
+    return region != MAP_FAILED ? region : NULL;
+}
+
+static void futex_wait(uint32_t *word, uint32_t value, int ms)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = ms / 1000;
+    timeout.tv_nsec = (ms % 1000) * 1000000L;
+    /* EAGAIN if the value changed, EINTR on a signal: the caller looks again */
+    (void) syscall(SYS_futex, word, FUTEX_WAIT, value, ms >= 0 ? &timeout : NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t *word)
+{
+    (void) syscall(SYS_futex, word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
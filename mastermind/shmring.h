@@ -0,0 +1,249 @@
+/**
+ * @file shmring.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief shared memory transport of the legacy protocol for clients on the
+ * server's host
+ *
+ * @details
+ *    the server (-m) creates the region SHM_NAME_FORMAT with its port in
+ *    /dev/shm. The region holds SHM_CHANNELS channels, a client claims a
+ *    free one in place of a connection and plays one game over it: its
+ *    guesses go into the request ring, the server puts the answers into
+ *    the answer ring. The messages are the ones of the legacy protocol
+ *    (the encoded guess and one answer byte), so the server plays them by
+ *    the same rules as on a socket.
+ *
+ *    each side spins a little while waiting and then sleeps on a futex in
+ *    the region, the other side only makes the wake system call if the
+ *    waiting side announced that it sleeps. A client may busy-poll instead,
+ *    then the server does not sleep either while the client plays. With a
+ *    single CPU online nobody spins and pollers yield the CPU on every look
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "mastermind.h"
+
+/* === Constants === */
+
+/** name of the region of a server port, see shm_open(3) */
+#define SHM_NAME_FORMAT "/mastermind-%ld"
+
+/** "mmsh" */
+#define SHM_MAGIC (0x68736d6d)
+
+/** layout version of the region */
+#define SHM_VERSION (1)
+
+/** number of channels, clients playing at the same time */
+#define SHM_CHANNELS (64)
+
+/** messages per ring, a power of two */
+#define SHM_RING_SLOTS (16)
+
+/** iterations a waiting side spins before it sleeps (or yields when it
+    busy-polls), none on a single CPU where the other side cannot run */
+#define SHM_SPINS (2000)
+
+/** alignment of the fields written by different sides */
+#define SHM_LINE (64)
+
+/* === Type Definitions === */
+
+/** a channel, one game between one client and the server */
+struct shm_channel {
+    /* incremented on claim and release, odd while a client owns the channel */
+    uint32_t owner;
+    /* process id of the owning client */
+    int32_t pid;
+    /* the client busy-polls, the server must not sleep */
+    uint32_t poll;
+    /* written by the client: requests [req_head, req_tail) */
+    uint32_t req_tail __attribute__((aligned(SHM_LINE)));
+    code_t requests[SHM_RING_SLOTS];
+    /* the client sleeps until resp_tail changes */
+    uint32_t client_sleeping;
+    /* written by the server: requests taken, answers [resp_head, resp_tail) */
+    uint32_t req_head __attribute__((aligned(SHM_LINE)));
+    uint32_t resp_tail;
+    uint8_t answers[SHM_RING_SLOTS];
+    /* written by the client again, kept apart from the server's line */
+    uint32_t resp_head __attribute__((aligned(SHM_LINE)));
+} __attribute__((aligned(SHM_LINE)));
+
+/** the shared region */
+struct shm_region {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t colors;
+    uint32_t code_bytes;
+    /* process id of the server */
+    int32_t server;
+    /* set when the server shuts down */
+    uint32_t quit;
+    /* incremented by every request, the server sleeps until it changes */
+    uint32_t doorbell __attribute__((aligned(SHM_LINE)));
+    uint32_t server_sleeping;
+    struct shm_channel channels[SHM_CHANNELS];
+};
+
+/* === Prototypes === */
+
+/**
+ * shm_create
+ * @brief Create and map the region of a port, replacing a stale one
+ * @param port The server port
+ * @return The region, NULL with errno set on error
+ */
+struct shm_region *shm_create(long port);
+
+/**
+ * shm_attach
+ * @brief Map the region of a running server
+ * @param port The server port
+ * @return The region, NULL with errno set on error (EINVAL if it was
+ * created for a different game size)
+ */
+struct shm_region *shm_attach(long port);
+
+/**
+ * shm_detach
+ * @brief Unmap a region
+ * @param region The region
+ */
+void shm_detach(struct shm_region *region);
+
+/**
+ * shm_stop
+ * @brief Set quit and wake the server and all sleeping clients, so they see it
+ * @param region The region
+ */
+void shm_stop(struct shm_region *region);
+
+/**
+ * shm_destroy
+ * @brief Remove the region of a port and unmap it, call after shm_stop()
+ * once the server no longer serves it
+ * @param region The region
+ * @param port The server port
+ */
+void shm_destroy(struct shm_region *region, long port);
+
+/**
+ * shm_claim
+ * @brief Claim a free channel for a new game, taking over channels of
+ * clients that exited without releasing them
+ * @param region The region
+ * @param poll The client busy-polls instead of sleeping
+ * @return The channel, NULL if all channels are in use
+ */
+struct shm_channel *shm_claim(struct shm_region *region, int poll);
+
+/**
+ * shm_release
+ * @brief Give a channel back once its game is over
+ * @param channel The channel
+ */
+void shm_release(struct shm_channel *channel);
+
+/**
+ * shm_send
+ * @brief Queue a request of the client and ring the server's doorbell
+ * @param region The region
+ * @param channel The claimed channel
+ * @param guess The encoded guess including the parity bit
+ * @return 0 on success, -1 if the request ring is full
+ */
+int shm_send(struct shm_region *region, struct shm_channel *channel, code_t guess);
+
+/**
+ * shm_receive
+ * @brief Wait for the next answer of the server
+ * @param region The region
+ * @param channel The claimed channel
+ * @param answer Set to the answer
+ * @return 0 on success, -1 if the server quit or died
+ */
+int shm_receive(struct shm_region *region, struct shm_channel *channel, uint8_t *answer);
+
+/**
+ * shm_answer
+ * @brief Queue an answer of the server and wake the client if it sleeps
+ * @param channel The channel
+ * @param answer The answer
+ */
+void shm_answer(struct shm_channel *channel, uint8_t answer);
+
+/**
+ * shm_server_wait
+ * @brief Sleep until a client rings the doorbell
+ * @param region The region
+ * @param doorbell Doorbell value read before the last look for requests
+ * @param pending Looks for requests once more after the server announced
+ * that it sleeps, the sleep is skipped if it returns non-zero
+ * @param arg Argument of pending
+ */
+void shm_server_wait(struct shm_region *region, uint32_t doorbell,
+                     int (*pending)(void *arg), void *arg);
+
+/**
+ * shm_spins
+ * @brief Number of iterations to spin before sleeping or yielding
+ * @return SHM_SPINS, 0 with a single CPU online
+ */
+int shm_spins(void);
+
+/**
+ * shm_doorbell
+ * @brief Current doorbell value, read before looking for requests
+ * @param region The region
+ * @return The value
+ */
+static inline uint32_t shm_doorbell(struct shm_region *region)
+{
+    return __atomic_load_n(&region->doorbell, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * shm_request
+ * @brief Take the next request of a channel
+ * @param channel The channel
+ * @param guess Set to the encoded guess
+ * @return 1 if there was a request, else 0
+ */
+static inline int shm_request(struct shm_channel *channel, code_t *guess)
+{
+    uint32_t head = channel->req_head;
+
+    if (head == __atomic_load_n(&channel->req_tail, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    *guess = channel->requests[head % SHM_RING_SLOTS];
+    __atomic_store_n(&channel->req_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/**
+ * shm_relax
+ * @brief Tell the CPU that the thread spins
+ */
+static inline void shm_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+#endif /* SHMRING_H */
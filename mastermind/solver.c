@@ -0,0 +1,879 @@
+/**
+ * @file solver.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief guess selection of the mastermind client
+ *
+ * @details
+ *    ranking a guess scores it against every candidate and counts the
+ *    candidates per answer. Ranking stops early once a guess is already
+ *    worse than the best one of its thread, and the whole sweep stops at
+ *    the first guess that gives every candidate its own answer, nothing can
+ *    beat that. Threads take chunks of guesses from a shared counter and
+ *    merge their best guess at the end, ties go to the lower index, so the
+ *    result does not depend on the number of threads
+ *
+ *    the strategies are the entries of the policy table: a consistent one
+ *    only brings a pick function, a ranked one the cost of a block of
+ *    scored candidates and the cost of a perfect guess
+ *
+ * @date 17.10.2015
+ *
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "solver.h"
+#include "score.h"
+
+/* === Constants === */
+
+/* number of different scores, red | white << SCORE_WHITE_SHIFT */
+#define SCORE_VALUES (SCORE_MASK + 1)
+
+/* bits per answer in the history of a game */
+#define HISTORY_BITS (PARITY_ERR_BIT)
+
+/* rounds that fit into the history, later rounds are not cached */
+#define HISTORY_ROUNDS (10)
+
+/* position of the strategy in a cache key */
+#define KEY_STRATEGY_SHIFT (HISTORY_BITS * HISTORY_ROUNDS)
+
+/* guesses a thread takes from the shared counter at once */
+#define CHUNK_GUESSES (64)
+
+/* candidates scored before ranking checks if it can stop */
+#define BLOCK_CODES (512)
+
+/* initial number of cache entries, a power of two */
+#define CACHE_MIN_SIZE (1024)
+
+/* first guess of the last strategy in the classic game */
+#if SLOTS == 5 && COLORS == 8
+enum { beige = 0, darkblue, green, orange, red, black, violet, white };
+#define LAST_OPENING ((beige << 4*SHIFT_WIDTH) | (orange << 3*SHIFT_WIDTH) | \
+                      (darkblue << 2*SHIFT_WIDTH) | (red << SHIFT_WIDTH) | green)
+#endif
+
+/* === Type Definitions === */
+
+/* a strategy */
+struct policy {
+    const char *name;
+    /* consistent strategies: the next guess, -1 if there are no candidates */
+    int (*pick)(struct solver *solver);
+    /* ranked strategies: count a block of scores into the groups, returns
+       the cost so far */
+    double (*cost)(uint16_t *groups, const uint8_t *scores, int len, double cost);
+    /* cost of a guess that gives each of n candidates its own answer */
+    double (*perfect)(int n);
+    /* the cost never shrinks with more candidates, so ranking a guess may
+       stop once it is above the best one */
+    bool growing;
+};
+
+/* one sweep over the guesses */
+struct job {
+    /* candidates the guesses are ranked against */
+    const code_t *set;
+    int n;
+    /* guesses in order of preference */
+    const code_t *guesses;
+    int count;
+    const struct policy *policy;
+    /* cost of a guess that gives every candidate its own answer */
+    double perfect;
+    /* next chunk of guesses, taken with atomic adds */
+    int next;
+    /* lowest index of a perfect guess found so far */
+    int stop;
+    /* best guess of the finished threads, protected by pool.lock */
+    double best_cost;
+    int best_index;
+};
+
+/* an entry of the guess cache, key 0 marks a free entry */
+struct cache_entry {
+    uint64_t key;
+    code_t guess;
+};
+
+/* === Global Variables === */
+
+/* seed of the next solver of the random strategy */
+static uint64_t random_seed;
+
+/* first guess of every strategy */
+static code_t openings[SOLVER_STRATEGIES];
+
+/* (c + 1) log2 (c + 1) - c log2 c, cost of the entropy strategy */
+static double entropy_step[SOLVER_RANK_CODES];
+
+/* threads ranking guesses besides the one calling solver_update() */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    /* one sweep at a time */
+    pthread_mutex_t busy;
+    pthread_t threads[SOLVER_MAX_THREADS];
+    int count;
+    /* incremented for every sweep */
+    unsigned long generation;
+    /* threads still working on the current sweep */
+    int running;
+    int quit;
+    struct job *job;
+} pool = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER
+};
+
+/* guess picked for every answer history seen so far */
+static struct {
+    pthread_mutex_t lock;
+    struct cache_entry *entries;
+    size_t size;
+    size_t used;
+} cache = { PTHREAD_MUTEX_INITIALIZER };
+
+/* === Prototypes === */
+
+/**
+ * pick_first
+ * @brief Lowest candidate
+ * @param solver The solver
+ * @return The code, -1 if there are no candidates
+ */
+static int pick_first(struct solver *solver);
+
+/**
+ * pick_last
+ * @brief Highest candidate
+ * @param solver The solver
+ * @return The code, -1 if there are no candidates
+ */
+static int pick_last(struct solver *solver);
+
+/**
+ * pick_random
+ * @brief Uniformly chosen candidate
+ * @param solver The solver
+ * @return The code, -1 if there are no candidates
+ */
+static int pick_random(struct solver *solver);
+
+/**
+ * cost_minimax
+ * @brief Size of the largest group
+ * @param groups Size of the group of every score
+ * @param scores Scores of a block of candidates
+ * @param len Number of scores
+ * @param cost Cost of the previous blocks
+ * @return The cost including the block
+ */
+static double cost_minimax(uint16_t *groups, const uint8_t *scores, int len, double cost);
+
+/**
+ * cost_expected
+ * @brief Sum of the squared group sizes, n times the expected number of
+ * candidates left
+ * @param groups Size of the group of every score
+ * @param scores Scores of a block of candidates
+ * @param len Number of scores
+ * @param cost Cost of the previous blocks
+ * @return The cost including the block
+ */
+static double cost_expected(uint16_t *groups, const uint8_t *scores, int len, double cost);
+
+/**
+ * cost_entropy
+ * @brief Sum of size * log2(size) over the groups, n * log2(n) - n * entropy
+ * @param groups Size of the group of every score
+ * @param scores Scores of a block of candidates
+ * @param len Number of scores
+ * @param cost Cost of the previous blocks
+ * @return The cost including the block
+ */
+static double cost_entropy(uint16_t *groups, const uint8_t *scores, int len, double cost);
+
+/**
+ * cost_parts
+ * @brief Negated number of groups
+ * @param groups Size of the group of every score
+ * @param scores Scores of a block of candidates
+ * @param len Number of scores
+ * @param cost Cost of the previous blocks
+ * @return The cost including the block
+ */
+static double cost_parts(uint16_t *groups, const uint8_t *scores, int len, double cost);
+
+/**
+ * perfect_one
+ * @brief Perfect cost of minimax
+ * @param n Number of candidates
+ * @return 1
+ */
+static double perfect_one(int n);
+
+/**
+ * perfect_n
+ * @brief Perfect cost of expected
+ * @param n Number of candidates
+ * @return n
+ */
+static double perfect_n(int n);
+
+/**
+ * perfect_zero
+ * @brief Perfect cost of entropy
+ * @param n Number of candidates
+ * @return 0
+ */
+static double perfect_zero(int n);
+
+/**
+ * perfect_parts
+ * @brief Perfect cost of parts
+ * @param n Number of candidates
+ * @return -n
+ */
+static double perfect_parts(int n);
+
+/**
+ * pool_worker
+ * @brief Thread function, works on every sweep posted to the pool
+ * @param arg unused
+ * @return NULL
+ */
+static void *pool_worker(void *arg);
+
+/**
+ * sweep
+ * @brief Rank all guesses of a job with every thread of the pool
+ * @param job The job, only set, n, guesses, count and policy need to be set
+ * @return Index of the best guess, -1 if there are no guesses
+ */
+static int sweep(struct job *job);
+
+/**
+ * run_job
+ * @brief Rank chunks of guesses until the job is done and merge the best one
+ * @param job The job
+ */
+static void run_job(struct job *job);
+
+/**
+ * rank_guess
+ * @brief Cost of a guess, lower is better
+ * @param job The job
+ * @param guess The guess
+ * @param limit Ranking may stop once the cost is above the limit
+ * @return The cost, or a value above limit
+ */
+static double rank_guess(const struct job *job, code_t guess, double limit);
+
+/**
+ * pick_guess
+ * @brief Rank every code against the candidates of a game
+ * @param set The candidates
+ * @param used Bitmask of the colors used by the guesses so far
+ * @param strategy A ranked strategy
+ * @return The best guess
+ */
+static code_t pick_guess(const struct candidates *set, unsigned used, enum solver_strategy strategy);
+
+/**
+ * canonical
+ * @brief Test if a code uses the colors no guess used so far in ascending order
+ * @details swapping two unused colors changes neither the candidates nor the
+ * cost of a guess, so only one code of every such class is ranked
+ * @param code The code
+ * @param used Bitmask of the colors used by the guesses so far
+ * @return 1 if the code is ranked, else 0
+ */
+static int canonical(code_t code, unsigned used);
+
+/**
+ * cache_lookup
+ * @brief Find the guess of an answer history
+ * @param key History and strategy
+ * @param guess Set to the guess if found
+ * @return 1 if found, else 0
+ */
+static int cache_lookup(uint64_t key, code_t *guess);
+
+/**
+ * cache_store
+ * @brief Remember the guess of an answer history, nothing happens if the
+ * cache can not grow
+ * @param key History and strategy
+ * @param guess The guess
+ */
+static void cache_store(uint64_t key, code_t guess);
+
+/**
+ * cache_slot
+ * @brief Find the entry of a key or the free entry it belongs to
+ * @param entries The entries
+ * @param size Number of entries, a power of two
+ * @param key The key
+ * @return The entry
+ */
+static struct cache_entry *cache_slot(struct cache_entry *entries, size_t size, uint64_t key);
+
+/* the strategies, indexed by enum solver_strategy */
+static const struct policy policies[SOLVER_STRATEGIES] = {
+    [SOLVER_FIRST] = { "first", pick_first, NULL, NULL, false },
+    [SOLVER_LAST] = { "last", pick_last, NULL, NULL, false },
+    [SOLVER_RANDOM] = { "random", pick_random, NULL, NULL, false },
+    [SOLVER_MINIMAX] = { "minimax", NULL, cost_minimax, perfect_one, true },
+    [SOLVER_EXPECTED] = { "expected", NULL, cost_expected, perfect_n, true },
+    [SOLVER_ENTROPY] = { "entropy", NULL, cost_entropy, perfect_zero, true },
+    [SOLVER_PARTS] = { "parts", NULL, cost_parts, perfect_parts, false }
+};
+
+/* === Implementations === */
+
+int solver_setup(int threads)
+{
+#ifdef SOLVER_RANKED
+    static struct candidates all;
+#endif
+    sigset_t blocked, old;
+
+    for (int c = 0; c < SOLVER_RANK_CODES; c++) {
+        entropy_step[c] = (c + 1) * log2(c + 1) - (c > 0 ? c * log2(c) : 0.0);
+    }
+
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? online : 1;
+    }
+    if (threads > SOLVER_MAX_THREADS) {
+        threads = SOLVER_MAX_THREADS;
+    }
+
+    /* the workers never handle signals, the caller's threads do */
+    (void) sigfillset(&blocked);
+    (void) pthread_sigmask(SIG_BLOCK, &blocked, &old);
+    while (pool.count < threads - 1) {
+        if (pthread_create(&pool.threads[pool.count], NULL, pool_worker, NULL) != 0) {
+            (void) pthread_sigmask(SIG_SETMASK, &old, NULL);
+            return -1;
+        }
+        pool.count++;
+    }
+    (void) pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    /* the consistent strategies share the opening of last */
+#ifdef LAST_OPENING
+    openings[SOLVER_LAST] = LAST_OPENING;
+#else
+    /* a different color in every slot, as far as there are colors */
+    openings[SOLVER_LAST] = 0;
+    for (int i = 0; i < SLOTS; i++) {
+        openings[SOLVER_LAST] |= (code_t) (i % COLORS) << (i * SHIFT_WIDTH);
+    }
+#endif
+#ifdef SOLVER_RANKED
+    candidates_fill(&all);
+#endif
+    for (int s = 0; s < SOLVER_STRATEGIES; s++) {
+        if (policies[s].pick != NULL) {
+            openings[s] = openings[SOLVER_LAST];
+        }
+#ifdef SOLVER_RANKED
+        else {
+            openings[s] = pick_guess(&all, 0, s);
+        }
+#endif
+    }
+    return 0;
+}
+
+void solver_shutdown(void)
+{
+    (void) pthread_mutex_lock(&pool.lock);
+    pool.quit = 1;
+    (void) pthread_cond_broadcast(&pool.start);
+    (void) pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < pool.count; i++) {
+        (void) pthread_join(pool.threads[i], NULL);
+    }
+    pool.count = 0;
+    pool.quit = 0;
+
+    free(cache.entries);
+    cache.entries = NULL;
+    cache.size = cache.used = 0;
+}
+
+int solver_strategy_parse(const char *name, enum solver_strategy *strategy)
+{
+    for (int s = 0; s < SOLVER_STRATEGIES; s++) {
+        if (solver_strategy_available(s) && strcmp(name, policies[s].name) == 0) {
+            *strategy = s;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *solver_strategy_name(enum solver_strategy strategy)
+{
+    return policies[strategy].name;
+}
+
+int solver_strategy_available(enum solver_strategy strategy)
+{
+#ifdef SOLVER_RANKED
+    return 1;
+#else
+    return policies[strategy].pick != NULL;
+#endif
+}
+
+const char *solver_strategy_list(void)
+{
+    static char list[128];
+
+    if (list[0] == '\0') {
+        for (int s = 0; s < SOLVER_STRATEGIES; s++) {
+            if (solver_strategy_available(s)) {
+                if (list[0] != '\0') {
+                    (void) strcat(list, ", ");
+                }
+                (void) strcat(list, policies[s].name);
+            }
+        }
+    }
+    return list;
+}
+
+void solver_init(struct solver *solver, enum solver_strategy strategy)
+{
+    candidates_fill(&solver->candidates);
+    solver->strategy = strategy;
+    solver->guess = openings[strategy];
+    solver->rounds = 0;
+    solver->colors = 0;
+    solver->history = 0;
+    solver->random = __atomic_add_fetch(&random_seed, 0x9e3779b97f4a7c15ULL, __ATOMIC_RELAXED);
+    solver->tree = NULL;
+    solver->node = TREE_NONE;
+    solver->foreign = 0;
+}
+
+void solver_follow(struct solver *solver, const struct tree *tree)
+{
+    solver->tree = tree;
+    solver->node = 0;
+    solver->guess = tree->nodes[0].guess;
+}
+
+code_t solver_next_guess(struct solver *solver)
+{
+    code_t guess = solver->guess;
+
+    solver->rounds++;
+    /* remove current guess from solutions */
+    candidates_remove(&solver->candidates, guess);
+    for (int i = 0; i < SLOTS; i++) {
+        solver->colors |= 1 << ((guess >> (i * SHIFT_WIDTH)) & SLOT_MASK);
+    }
+
+    /* calculate parity bit for guess */
+    return guess | ((code_t) code_parity(guess) << PARITY_BIT);
+}
+
+void solver_update(struct solver *solver, uint8_t answer)
+{
+    uint8_t score = answer & SCORE_MASK;
+    uint64_t key = 0;
+    int next;
+
+    /* one lookup, the candidates are not needed */
+    if (solver->tree != NULL) {
+        if (solver->node != TREE_NONE) {
+            solver->node = tree_child(solver->tree, solver->node, score);
+        }
+        if (solver->node != TREE_NONE) {
+            solver->guess = solver->tree->nodes[solver->node].guess;
+        }
+        return;
+    }
+
+    /* knuth alg - remove non possible solutions */
+    candidates_filter(&solver->candidates, solver->guess, score);
+
+    if (policies[solver->strategy].pick != NULL) {
+        /* pick next guess among the candidates left */
+        next = policies[solver->strategy].pick(solver);
+        if (next >= 0) {
+            solver->guess = next;
+        }
+        return;
+    }
+
+    /* the candidates only depend on the answers, the guesses follow from them */
+    if (solver->rounds <= HISTORY_ROUNDS && !solver->foreign) {
+        solver->history = (solver->history << HISTORY_BITS) | (score + 1);
+        key = solver->history | ((uint64_t) solver->strategy << KEY_STRATEGY_SHIFT);
+    } else {
+        solver->history = 0;
+    }
+    if (key != 0 && cache_lookup(key, &solver->guess)) {
+        return;
+    }
+    solver->guess = pick_guess(&solver->candidates, solver->colors, solver->strategy);
+    if (key != 0) {
+        cache_store(key, solver->guess);
+    }
+}
+
+void solver_replay(struct solver *solver, code_t guess, uint8_t answer)
+{
+    uint8_t score = answer & SCORE_MASK;
+
+    guess &= CODE_MASK;
+    if (guess != solver->guess) {
+        /* the candidates no longer follow from the answers alone */
+        solver->tree = NULL;
+        solver->node = TREE_NONE;
+        solver->foreign = 1;
+        solver->guess = guess;
+    }
+    (void) solver_next_guess(solver);
+    if (score == SCORE_WON) {
+        return;
+    }
+    /* kept up to date in case a later guess leaves the tree */
+    if (solver->tree != NULL) {
+        candidates_filter(&solver->candidates, guess, score);
+    }
+    solver_update(solver, answer);
+}
+
+static code_t pick_guess(const struct candidates *set, unsigned used, enum solver_strategy strategy)
+{
+    code_t codes[CODES];
+    code_t guesses[CODES];
+    struct job job;
+    int n = 0, count = 0;
+
+    /* candidates first, a guess that may win is preferred on equal cost */
+    for (int w = 0; w < CANDIDATE_WORDS; w++) {
+        for (uint64_t bits = set->bits[w]; bits != 0; bits &= bits - 1) {
+            code_t code = w * CANDIDATE_WORD_BITS + __builtin_ctzll(bits);
+            if (set->count < 0) {
+                codes[n++] = code;
+            }
+            if (canonical(code, used)) {
+                guesses[count++] = code;
+            }
+        }
+    }
+    for (int w = 0; w < CANDIDATE_WORDS; w++) {
+        for (uint64_t bits = ~set->bits[w] & score_valid[w]; bits != 0; bits &= bits - 1) {
+            code_t code = w * CANDIDATE_WORD_BITS + __builtin_ctzll(bits);
+            if (canonical(code, used)) {
+                guesses[count++] = code;
+            }
+        }
+    }
+
+    job.set = set->count >= 0 ? set->dense : codes;
+    job.n = set->count >= 0 ? set->count : n;
+    job.guesses = guesses;
+    job.count = count;
+    job.policy = &policies[strategy];
+    return guesses[sweep(&job)];
+}
+
+static int canonical(code_t code, unsigned used)
+{
+    for (int i = 0; i < SLOTS; i++) {
+        unsigned color = (code >> (i * SHIFT_WIDTH)) & SLOT_MASK;
+        if ((used & (1u << color)) == 0) {
+            /* the first new color has to be the lowest unused one */
+            if (color != __builtin_ctz(~used)) {
+                return 0;
+            }
+            used |= 1u << color;
+        }
+    }
+    return 1;
+}
+
+static int sweep(struct job *job)
+{
+    job->perfect = job->policy->perfect(job->n);
+    job->next = 0;
+    job->stop = job->count;
+    job->best_cost = HUGE_VAL;
+    job->best_index = -1;
+
+    /* without a pool every caller ranks on its own thread */
+    if (pool.count == 0) {
+        run_job(job);
+        return job->best_index;
+    }
+
+    (void) pthread_mutex_lock(&pool.busy);
+    (void) pthread_mutex_lock(&pool.lock);
+    pool.job = job;
+    pool.running = pool.count;
+    pool.generation++;
+    (void) pthread_cond_broadcast(&pool.start);
+    (void) pthread_mutex_unlock(&pool.lock);
+    run_job(job);
+    (void) pthread_mutex_lock(&pool.lock);
+    while (pool.running > 0) {
+        (void) pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    (void) pthread_mutex_unlock(&pool.lock);
+    (void) pthread_mutex_unlock(&pool.busy);
+    return job->best_index;
+}
+
+static void *pool_worker(void *arg)
+{
+    unsigned long seen = 0;
+
+    (void) pthread_mutex_lock(&pool.lock);
+    while (true) {
+        struct job *job;
+
+        while (pool.generation == seen && !pool.quit) {
+            (void) pthread_cond_wait(&pool.start, &pool.lock);
+        }
+        if (pool.quit) {
+            break;
+        }
+        seen = pool.generation;
+        job = pool.job;
+        (void) pthread_mutex_unlock(&pool.lock);
+
+        run_job(job);
+
+        (void) pthread_mutex_lock(&pool.lock);
+        if (--pool.running == 0) {
+            (void) pthread_cond_signal(&pool.done);
+        }
+    }
+    (void) pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static void run_job(struct job *job)
+{
+    double best = HUGE_VAL;
+    int best_index = -1;
+    int start;
+
+    while ((start = __atomic_fetch_add(&job->next, CHUNK_GUESSES, __ATOMIC_RELAXED)) < job->count) {
+        int end = start + CHUNK_GUESSES < job->count ? start + CHUNK_GUESSES : job->count;
+
+        /* a perfect guess was found before this chunk */
+        if (start > __atomic_load_n(&job->stop, __ATOMIC_RELAXED)) {
+            break;
+        }
+        for (int i = start; i < end; i++) {
+            double cost = rank_guess(job, job->guesses[i], best);
+            if (cost < best) {
+                best = cost;
+                best_index = i;
+            }
+        }
+        if (best == job->perfect) {
+            int stop = __atomic_load_n(&job->stop, __ATOMIC_RELAXED);
+            while (best_index < stop &&
+                   !__atomic_compare_exchange_n(&job->stop, &stop, best_index, false,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                /* stop was reloaded, try again */
+            }
+            break;
+        }
+    }
+
+    (void) pthread_mutex_lock(&pool.lock);
+    if (best_index >= 0 && (best < job->best_cost ||
+                            (best == job->best_cost && best_index < job->best_index))) {
+        job->best_cost = best;
+        job->best_index = best_index;
+    }
+    (void) pthread_mutex_unlock(&pool.lock);
+}
+
+static double rank_guess(const struct job *job, code_t guess, double limit)
+{
+    uint8_t scores[BLOCK_CODES];
+    uint16_t groups[SCORE_VALUES];
+    double cost = 0;
+
+    (void) memset(groups, 0, sizeof groups);
+    for (int off = 0; off < job->n; off += BLOCK_CODES) {
+        int len = job->n - off < BLOCK_CODES ? job->n - off : BLOCK_CODES;
+
+        score_codes(guess, job->set + off, len, scores);
+        cost = job->policy->cost(groups, scores, len, cost);
+        if (job->policy->growing && cost > limit) {
+            break;
+        }
+    }
+    return cost;
+}
+
+static int pick_first(struct solver *solver)
+{
+    return candidates_first(&solver->candidates);
+}
+
+static int pick_last(struct solver *solver)
+{
+    return candidates_last(&solver->candidates);
+}
+
+static int pick_random(struct solver *solver)
+{
+    int count = candidates_count(&solver->candidates);
+    uint64_t z;
+    int k;
+
+    if (count == 0) {
+        return -1;
+    }
+    /* splitmix64, scaled to the number of candidates */
+    z = solver->random += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    k = ((z >> 32) * count) >> 32;
+
+    return candidates_select(&solver->candidates, k);
+}
+
+static double cost_minimax(uint16_t *groups, const uint8_t *scores, int len, double cost)
+{
+    for (int i = 0; i < len; i++) {
+        uint16_t size = ++groups[scores[i]];
+        if (size > cost) {
+            cost = size;
+        }
+    }
+    return cost;
+}
+
+static double cost_expected(uint16_t *groups, const uint8_t *scores, int len, double cost)
+{
+    for (int i = 0; i < len; i++) {
+        cost += 2 * groups[scores[i]]++ + 1;
+    }
+    return cost;
+}
+
+static double cost_entropy(uint16_t *groups, const uint8_t *scores, int len, double cost)
+{
+    for (int i = 0; i < len; i++) {
+        cost += entropy_step[groups[scores[i]]++];
+    }
+    return cost;
+}
+
+static double cost_parts(uint16_t *groups, const uint8_t *scores, int len, double cost)
+{
+    for (int i = 0; i < len; i++) {
+        if (groups[scores[i]]++ == 0) {
+            cost--;
+        }
+    }
+    return cost;
+}
+
+static double perfect_one(int n)
+{
+    return 1;
+}
+
+static double perfect_n(int n)
+{
+    return n;
+}
+
+static double perfect_zero(int n)
+{
+    return 0;
+}
+
+static double perfect_parts(int n)
+{
+    return -n;
+}
+
+static int cache_lookup(uint64_t key, code_t *guess)
+{
+    int found = 0;
+
+    (void) pthread_mutex_lock(&cache.lock);
+    if (cache.entries != NULL) {
+        struct cache_entry *entry = cache_slot(cache.entries, cache.size, key);
+        if (entry->key == key) {
+            *guess = entry->guess;
+            found = 1;
+        }
+    }
+    (void) pthread_mutex_unlock(&cache.lock);
+    return found;
+}
+
+static void cache_store(uint64_t key, code_t guess)
+{
+    struct cache_entry *entry;
+
+    (void) pthread_mutex_lock(&cache.lock);
+    /* keep the table at most half full */
+    if (2 * (cache.used + 1) > cache.size) {
+        size_t size = cache.size > 0 ? 2 * cache.size : CACHE_MIN_SIZE;
+        struct cache_entry *entries = calloc(size, sizeof *entries);
+
+        if (entries == NULL) {
+            (void) pthread_mutex_unlock(&cache.lock);
+            return;
+        }
+        for (size_t i = 0; i < cache.size; i++) {
+            if (cache.entries[i].key != 0) {
+                *cache_slot(entries, size, cache.entries[i].key) = cache.entries[i];
+            }
+        }
+        free(cache.entries);
+        cache.entries = entries;
+        cache.size = size;
+    }
+    entry = cache_slot(cache.entries, cache.size, key);
+    if (entry->key == 0) {
+        entry->key = key;
+        entry->guess = guess;
+        cache.used++;
+    }
+    (void) pthread_mutex_unlock(&cache.lock);
+}
+
+static struct cache_entry *cache_slot(struct cache_entry *entries, size_t size, uint64_t key)
+{
+    /* fibonacci hashing, linear probing */
+    size_t i = (key * 0x9e3779b97f4a7c15ULL) >> 32;
+
+    for (i &= size - 1; entries[i].key != 0 && entries[i].key != key; i = (i + 1) & (size - 1)) {
+        /* probe the next entry */
+    }
+    return &entries[i];
+}
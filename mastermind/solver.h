@@ -0,0 +1,207 @@
+/**
+ * @file solver.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief guess selection of the mastermind client
+ *
+ * @details
+ *    a solver keeps the codes that may still be the secret and picks the
+ *    next guess with one of these strategies. The consistent ones take a
+ *    candidate without looking at the others:
+ *      - first: the lowest code that may still be the secret
+ *      - last: the highest code that may still be the secret
+ *      - random: any code that may still be the secret
+ *    the ranked ones try every code against every candidate, group the
+ *    candidates by the answer they would give and take the code with the
+ *    best groups:
+ *      - minimax: Knuth's rule, the smallest largest group
+ *      - expected: the smallest expected number of candidates left after
+ *        the answer
+ *      - entropy: the answer carrying the most information
+ *      - parts: the most groups
+ *
+ *    every strategy is an entry of a policy table in solver.c, a pick
+ *    function for the consistent ones and a group cost for the ranked ones,
+ *    so adding one does not touch the solver itself. Ranking is only
+ *    compiled in for games of up to SOLVER_RANK_CODES packed codes; larger
+ *    games only play the consistent strategies
+ *
+ *    instead of ranking, a solver can follow a decision tree built from one
+ *    of the strategies beforehand (see tree.h)
+ *
+ *    the ranked strategies try every code, codes that may still be the
+ *    secret first, and take the first best one. The sweep is split over the
+ *    threads started with solver_setup(). Games share a cache of the guesses
+ *    already picked for an answer history, so a run over many secrets ranks
+ *    every history only once
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdint.h>
+
+#include "mastermind.h"
+#include "candidates.h"
+#include "tree.h"
+
+/* === Constants === */
+
+/** maximum number of threads ranking guesses */
+#define SOLVER_MAX_THREADS (64)
+
+/** largest number of packed codes the ranked strategies are offered for */
+#define SOLVER_RANK_CODES (1 << 15)
+
+#if CODES <= SOLVER_RANK_CODES
+#define SOLVER_RANKED (1)
+#endif
+
+/* === Type Definitions === */
+
+/** how the next guess is picked */
+enum solver_strategy {
+    SOLVER_LAST,
+    SOLVER_MINIMAX,
+    SOLVER_EXPECTED,
+    SOLVER_ENTROPY,
+    SOLVER_FIRST,
+    SOLVER_RANDOM,
+    SOLVER_PARTS
+};
+
+/** number of strategies */
+#define SOLVER_STRATEGIES (SOLVER_PARTS + 1)
+
+/** strategy used if none is given */
+#ifdef SOLVER_RANKED
+#define SOLVER_DEFAULT (SOLVER_MINIMAX)
+#else
+#define SOLVER_DEFAULT (SOLVER_LAST)
+#endif
+
+/** state of the solver for one game */
+struct solver {
+    enum solver_strategy strategy;
+    /* next guess, without parity bit */
+    code_t guess;
+    int rounds;
+    /* bitmask of the colors used by the guesses so far */
+    uint16_t colors;
+    /* answers of the previous rounds, key of the guess cache */
+    uint64_t history;
+    /* codes that may still be the secret */
+    struct candidates candidates;
+    /* generator state of the random strategy */
+    uint64_t random;
+    /* decision tree followed instead of ranking, NULL if none */
+    const struct tree *tree;
+    /* node of the next guess, TREE_NONE once an answer left the tree */
+    int32_t node;
+    /* a replayed guess was not the solver's own, the guess cache is off */
+    int foreign;
+};
+
+/* === Prototypes === */
+
+/**
+ * solver_setup
+ * @brief Start the threads ranking guesses and pick the opening guesses,
+ * call once after score_init() and before any other function of this module
+ * @param threads Number of threads, including the calling one; 0 for one
+ * per online CPU. With 1 the games may be played on several threads of the
+ * caller, each ranking its own guesses; with more the sweeps take turns
+ * @return 0 on success, -1 if a thread could not be started
+ */
+int solver_setup(int threads);
+
+/**
+ * solver_shutdown
+ * @brief Stop the threads and free the guess cache
+ */
+void solver_shutdown(void);
+
+/**
+ * solver_strategy_parse
+ * @brief Look up a strategy by name
+ * @param name The name
+ * @param strategy Set to the strategy
+ * @return 0 on success, -1 if there is no strategy of that name or it is
+ * not available for the size of the game
+ */
+int solver_strategy_parse(const char *name, enum solver_strategy *strategy);
+
+/**
+ * solver_strategy_name
+ * @brief Name of a strategy
+ * @param strategy The strategy
+ * @return The name
+ */
+const char *solver_strategy_name(enum solver_strategy strategy);
+
+/**
+ * solver_strategy_available
+ * @brief Test if a strategy can be played in a game of this size
+ * @param strategy The strategy
+ * @return 1 if available, else 0
+ */
+int solver_strategy_available(enum solver_strategy strategy);
+
+/**
+ * solver_strategy_list
+ * @brief Names of the available strategies
+ * @return The names separated by ", "
+ */
+const char *solver_strategy_list(void);
+
+/**
+ * solver_init
+ * @brief Start a new game
+ * @param solver The solver
+ * @param strategy How the guesses of the game are picked
+ */
+void solver_init(struct solver *solver, enum solver_strategy strategy);
+
+/**
+ * solver_follow
+ * @brief Take the guesses of a decision tree, call right after solver_init()
+ * @details once the tree has no node for an answer the last guess is kept
+ * @param solver The solver
+ * @param tree The tree
+ */
+void solver_follow(struct solver *solver, const struct tree *tree);
+
+/**
+ * solver_next_guess
+ * @brief Take the next guess and remove it from the possible solutions
+ * @param solver The solver
+ * @return The encoded guess including the parity bit
+ */
+code_t solver_next_guess(struct solver *solver);
+
+/**
+ * solver_update
+ * @brief Remove the solutions contradicting the answer to the last guess
+ * and pick the next guess
+ * @param solver The solver
+ * @param answer The server's answer to the last guess
+ */
+void solver_update(struct solver *solver, uint8_t answer);
+
+/**
+ * solver_replay
+ * @brief Play a round of a resumed game again: take a guess the server
+ * answered before and update the solver with its answer, like
+ * solver_next_guess() and solver_update()
+ * @details a guess other than the one the solver would pick leaves the
+ * decision tree and the guess cache for the rest of the game
+ * @param solver The solver
+ * @param guess The encoded guess
+ * @param answer The server's answer to it
+ */
+void solver_replay(struct solver *solver, code_t guess, uint8_t answer);
+
+#endif /* SOLVER_H */
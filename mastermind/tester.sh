@@ -1,35 +1,16 @@
 #! /bin/sh
 
+# plays every secret of a code list once against a single server
+# (make perm.codes, or ./codeconv <text-file> <code-file> for a text list)
+
 port=30000;
 
-i=0;
-filename=perm.txt
+filename=${1:-perm.codes}
+games=$(./codeconv -d "$filename" | wc -l)
 
- 
-while read -r code
-do
-	#echo $i;
-	((port++));
-	./server $port $code &
-	#sleep 1
-	./client localhost $port > /dev/null 2>&1 &
-	
-done < "$filename"
+./server -e -s "$filename" $port &
+server=$!
+sleep 1
+./client -l 64 -m "$games" localhost $port
+kill -INT $server
 wait
-
-
-
-#for i in `seq 0 $(echo '8^5-1' | bc)`;
-#do 
-	#echo $i;
-
-	#0 = bbbbb
-	#1 = bbbbc
-
-	#./server $port 
-
-#done
-
-#perl -le '@c = ("b", "d", "g", "o", "r", "s", "v", "w");
-#          for $a (@c){for $b(@c){for $c(@c){for $d(@c){for $e(@c){
-#            print "$a$b$c$d$e"}}}}}' >> perm.txt
@@ -1,13 +1,15 @@
 #! /bin/sh
 
-#run this in shell to get test case file:
-#perl -le '@c = ("b","d","g","o","r","v","w");for $a (@c){for $b(@c){for $c(@c){for $d(@c){for $e(@c){print "$a$b$c$d$e"}}}}}' >> testcasefile
+# lists the secrets of a code list the client needs more than 7 rounds for
+# (make perm.codes, or ./codeconv <text-file> <code-file> for a text list)
 
 port=1280
 
-rm outputofcli.txt
+filename=${1:-perm.codes}
 
-while read line           
+rm -f outputofcli.txt
+
+./codeconv -d "$filename" | while read line
 do           
     ./server $port $line &
     i=$(./client localhost $port | grep -o '[0-9]*' | cut -c 1-3)
@@ -15,4 +17,4 @@ do
     	then
     	echo "$i $line" >> outputofcli.txt
     fi
-done < perm.txt
+done
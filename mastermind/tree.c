@@ -0,0 +1,102 @@
+/**
+ * @file tree.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief precomputed decision tree of a solver strategy
+ *
+ * @details
+ *    maps tree files written by buildtree. The header is checked against
+ *    the game the program was compiled for and every child index against
+ *    the number of nodes, so a lookup never leaves the mapping
+ *
+ * @date 17.10.2015
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tree.h"
+
+/* === Prototypes === */
+
+/**
+ * tree_valid
+ * @brief Check the header and the child indices of a mapped tree file
+ * @param tree The tree
+ * @return 1 if the tree can be used, else 0
+ */
+static int tree_valid(const struct tree *tree);
+
+/* === Implementations === */
+
+int tree_open(const char *path, struct tree *tree)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        (void) close(fd);
+        return -1;
+    }
+    if (st.st_size < (off_t) sizeof(struct tree_header)) {
+        (void) close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    (void) close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    tree->header = map;
+    tree->nodes = (const struct tree_node *) (tree->header + 1);
+    tree->size = st.st_size;
+    if (!tree_valid(tree)) {
+        tree_close(tree);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void tree_close(struct tree *tree)
+{
+    if (tree->header != NULL) {
+        (void) munmap((void *) tree->header, tree->size);
+    }
+    tree->header = NULL;
+    tree->nodes = NULL;
+    tree->size = 0;
+}
+
+static int tree_valid(const struct tree *tree)
+{
+    const struct tree_header *header = tree->header;
+
+    if (memcmp(header->magic, TREE_MAGIC, sizeof header->magic) != 0 ||
+        header->version != TREE_VERSION || header->byte_order != TREE_BYTE_ORDER ||
+        header->slots != SLOTS || header->colors != COLORS || header->nodes == 0 ||
+        (tree->size - sizeof *header) / sizeof(struct tree_node) < header->nodes) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < header->nodes; i++) {
+        const struct tree_node *node = &tree->nodes[i];
+        uint64_t last = node->first + (uint64_t) __builtin_popcountll(node->children);
+
+        if (node->children != 0 && (node->first <= i || last > header->nodes)) {
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file tree.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief precomputed decision tree of a solver strategy
+ *
+ * @details
+ *    the guess of a strategy only depends on the answers so far, so all
+ *    games fit into one tree, built once by buildtree. A node holds the
+ *    guess of its answer history; its children, one for every answer the
+ *    remaining candidates can give except the winning one, are stored next
+ *    to each other in order of the score. Child s of a node is at
+ *    first + popcount(children & ((1 << s) - 1)), so every round is a
+ *    lookup.
+ *
+ *    the file is a struct tree_header followed by the nodes, root first, in
+ *    the byte order of the machine that built it; it is mapped read only
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef TREE_H
+#define TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mastermind.h"
+
+/* === Constants === */
+
+/** first bytes of a tree file */
+#define TREE_MAGIC "MMDT"
+
+/** format version of a tree file */
+#define TREE_VERSION (2)
+
+/** tree_header.byte_order as written by the building machine */
+#define TREE_BYTE_ORDER (0x01020304)
+
+/** tree_child() result if the tree has no node for an answer */
+#define TREE_NONE (-1)
+
+/* === Type Definitions === */
+
+/** header of a tree file */
+struct tree_header {
+    char magic[4];
+    uint8_t version;
+    uint8_t slots;
+    uint8_t colors;
+    /* enum solver_strategy the tree was built with */
+    uint8_t strategy;
+    uint32_t byte_order;
+    /* number of nodes following the header */
+    uint32_t nodes;
+};
+
+/** node of a tree file */
+struct tree_node {
+    /* bit s set if the answer with score s has a child */
+    uint64_t children;
+    /* index of the child with the lowest score */
+    uint32_t first;
+    /* guess of this answer history, without parity bit */
+    uint32_t guess;
+};
+
+/** a mapped tree file */
+struct tree {
+    const struct tree_header *header;
+    const struct tree_node *nodes;
+    size_t size;
+};
+
+/* === Prototypes === */
+
+/**
+ * tree_open
+ * @brief Map a tree file and check its header
+ * @param path The file
+ * @param tree Set to the mapped tree
+ * @return 0 on success, -1 on error with errno set (EINVAL if the file is
+ * no tree of this game)
+ */
+int tree_open(const char *path, struct tree *tree);
+
+/**
+ * tree_close
+ * @brief Unmap a tree file
+ * @param tree The tree
+ */
+void tree_close(struct tree *tree);
+
+/**
+ * tree_child
+ * @brief Node reached from a node with an answer
+ * @param tree The tree
+ * @param node Index of the node
+ * @param score The score (red and white pins) of the answer
+ * @return Index of the child, TREE_NONE if the answer is not possible
+ */
+static inline int32_t tree_child(const struct tree *tree, uint32_t node, uint8_t score)
+{
+    uint64_t children = tree->nodes[node].children;
+
+    if (score >= 64 || ((children >> score) & 1) == 0) {
+        return TREE_NONE;
+    }
+    return tree->nodes[node].first + __builtin_popcountll(children & (((uint64_t) 1 << score) - 1));
+}
+
+#endif /* TREE_H */
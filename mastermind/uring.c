@@ -0,0 +1,129 @@
+/**
+ * @file uring.c
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief minimal io_uring submission and completion queues
+ *
+ * @date 17.10.2015
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+/* === Constants === */
+
+/* features the server relies on: one mapping for both rings, no lost
+   completions and sockets polled inline instead of by kernel workers */
+#define URING_FEATURES (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL)
+
+/* === Implementations === */
+
+int uring_init(struct uring *ring, unsigned entries)
+{
+    struct io_uring_params params;
+    size_t sq_size, cq_size;
+    char *map;
+    void *sqes;
+
+    memset(ring, 0, sizeof *ring);
+    memset(&params, 0, sizeof params);
+    ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+    if ((params.features & URING_FEATURES) != URING_FEATURES) {
+        (void) close(ring->fd);
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    /* submission and completion ring share one mapping */
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    map = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (map == MAP_FAILED) {
+        (void) close(ring->fd);
+        return -1;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        (void) munmap(map, ring->ring_size);
+        (void) close(ring->fd);
+        return -1;
+    }
+
+    ring->ring_map = map;
+    ring->sq_head = (unsigned *) (map + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (map + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (map + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (map + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->sqes = sqes;
+    ring->sq_queued = *ring->sq_tail;
+    ring->cq_head = (unsigned *) (map + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (map + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (map + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (map + params.cq_off.cqes);
+    return 0;
+}
+
+void uring_free(struct uring *ring)
+{
+    if (ring->ring_map == NULL) {
+        return;
+    }
+    (void) munmap(ring->sqes, ring->sqes_size);
+    (void) munmap(ring->ring_map, ring->ring_size);
+    (void) close(ring->fd);
+    ring->ring_map = NULL;
+    ring->fd = -1;
+}
+
+struct io_uring_sqe *uring_sqe(struct uring *ring)
+{
+    struct io_uring_sqe *sqe;
+    unsigned index;
+
+    if (ring->sq_queued - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == ring->sq_entries) {
+        if (uring_submit(ring, 0) < 0) {
+            return NULL;
+        }
+        if (ring->sq_queued - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == ring->sq_entries) {
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+    index = ring->sq_queued & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof *sqe);
+    ring->sq_array[index] = index;
+    ring->sq_queued++;
+    return sqe;
+}
+
+int uring_submit(struct uring *ring, unsigned wait)
+{
+    unsigned pending;
+    int r;
+
+    /* publish the queued entries, the kernel consumes them on enter */
+    __atomic_store_n(ring->sq_tail, ring->sq_queued, __ATOMIC_RELEASE);
+    pending = ring->sq_queued - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (pending == 0 && wait == 0) {
+        return 0;
+    }
+    r = syscall(__NR_io_uring_enter, ring->fd, pending, wait,
+                wait > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    return r < 0 ? -1 : 0;
+}
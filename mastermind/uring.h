@@ -0,0 +1,115 @@
+/**
+ * @file uring.h
+ *
+ * @author Thomas Muhm 1326486
+ *
+ * @brief minimal io_uring submission and completion queues
+ *
+ * @details
+ *    sets up an io_uring instance with the raw system calls and maps its
+ *    queues. Submission entries are queued with uring_sqe() and handed to
+ *    the kernel in one io_uring_enter() call by uring_submit(), which also
+ *    waits for completions; the completions are then consumed from the
+ *    shared ring without any further system call
+ *
+ * @date 17.10.2015
+ *
+ */
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/* === Type Definitions === */
+
+/** an io_uring instance and its mapped queues */
+struct uring {
+    int fd;
+    /* submission queue, shared with the kernel */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    /* tail including the entries queued but not yet submitted */
+    unsigned sq_queued;
+    /* completion queue, shared with the kernel */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    /* mappings */
+    void *ring_map;
+    size_t ring_size;
+    size_t sqes_size;
+};
+
+/* === Prototypes === */
+
+/**
+ * uring_init
+ * @brief Set up an io_uring instance
+ * @param ring The instance
+ * @param entries Size of the submission queue, a power of two
+ * @return 0 on success, -1 with errno set if the kernel has no io_uring
+ * or lacks a feature the server relies on (EOPNOTSUPP)
+ */
+int uring_init(struct uring *ring, unsigned entries);
+
+/**
+ * uring_free
+ * @brief Unmap the queues and close the instance, which cancels all
+ * pending requests
+ * @param ring The instance
+ */
+void uring_free(struct uring *ring);
+
+/**
+ * uring_sqe
+ * @brief Queue a submission entry, submitting the queued ones first if
+ * the queue is full
+ * @param ring The instance
+ * @return The zeroed entry, NULL with errno set if the submission failed
+ */
+struct io_uring_sqe *uring_sqe(struct uring *ring);
+
+/**
+ * uring_submit
+ * @brief Submit all queued entries and wait for completions
+ * @param ring The instance
+ * @param wait Number of completions to wait for, 0 to return at once
+ * @return 0 on success, -1 with errno set on error (EINTR if a signal
+ * interrupted the wait)
+ */
+int uring_submit(struct uring *ring, unsigned wait);
+
+/**
+ * uring_cqe
+ * @brief Next completion
+ * @param ring The instance
+ * @return The completion, NULL if there is none. It stays valid until
+ * uring_cqe_seen() is called
+ */
+static inline struct io_uring_cqe *uring_cqe(struct uring *ring)
+{
+    unsigned head = *ring->cq_head;
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+/**
+ * uring_cqe_seen
+ * @brief Hand the completion returned by uring_cqe() back to the kernel
+ * @param ring The instance
+ */
+static inline void uring_cqe_seen(struct uring *ring)
+{
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+#endif /* URING_H */